@@ -0,0 +1,70 @@
+#ifndef CHECKPOINT_H__
+  #define CHECKPOINT_H__
+
+  #include <Grid.h>
+  #include <InputData.h>
+
+  #include <boost/cstdint.hpp>
+  #include <boost/interprocess/file_mapping.hpp>
+  #include <boost/interprocess/mapped_region.hpp>
+  #include <string>
+
+  #define CHECKPOINT_MAGIC "RDCKPT01"
+  #define CHECKPOINT_VERSION 1
+
+  // Planes start on a page boundary so a mapped file can be uploaded directly
+  #define CHECKPOINT_DATA_OFFSET 4096
+
+  #define CHECKPOINT_RAW 0
+
+  // Fixed size header at the start of a checkpoint. It is followed by the a
+  // and b planes, each stored exactly as the padded fields are held in memory.
+  struct CheckpointHeader
+  {
+    char magic[8];
+    boost::uint32_t version;
+    boost::uint32_t compression;
+    boost::int32_t width;
+    boost::int32_t height;
+    boost::int32_t stride;
+    boost::uint32_t seed;
+    boost::uint64_t iteration;
+    boost::uint64_t plane_bytes;
+    InputData input;
+
+    // Planes of a volume, 0 in checkpoints written before volumes and read as 1
+    boost::uint32_t depth;
+  };
+
+  CheckpointHeader checkpoint_header(const Grid &_grid, const InputData &_input, const unsigned int _iteration, const unsigned int _seed);
+
+  // Write a checkpoint to a temporary file and rename it over the target, so a
+  // crash part way through never leaves a truncated checkpoint behind
+  bool write_checkpoint(const std::string &_filepath, const CheckpointHeader &_header, const float *_a, const float *_b);
+
+  // Checkpoints collected in parallel. One process writes the header to the
+  // temporary file, then every process writes its rows of both planes in
+  // place, starting from the first of them, and one process commits the file.
+  bool begin_checkpoint(const std::string &_filepath, const CheckpointHeader &_header);
+  bool write_checkpoint_rows(const std::string &_filepath, const CheckpointHeader &_header, const int _row, const int _rows, const float *_a, const float *_b);
+  bool commit_checkpoint(const std::string &_filepath);
+
+  // Checkpoint opened for restart. The file is memory mapped and the planes
+  // point straight into the mapping, so no parsing or copying is done here.
+  class Checkpoint
+  {
+  public:
+    Checkpoint(const std::string &_filepath);
+
+    const CheckpointHeader& header() const;
+    Grid grid() const;
+    const float* a() const;
+    const float* b() const;
+
+  private:
+    boost::interprocess::file_mapping m_file;
+    boost::interprocess::mapped_region m_region;
+    const CheckpointHeader *m_header;
+  };
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef CL_ENVIRONMENT_H__
+  #define CL_ENVIRONMENT_H__
+
+  #include <PlatformSpecification.h>
+  #include <Framebuffer.h>
+  #include <string>
+  #include <vector>
+
+  // Identifies program cache files and their format version
+  #define PROGRAM_CACHE_MAGIC "RDPRG001"
+
+  // OpenCL platform, devices and context shared by the solvers. With a
+  // framebuffer the context shares its GL context, otherwise it is headless
+  // and may fall back to any device type when no GPU is present. Built
+  // programs are kept as device binaries in the cache directory, if one is
+  // given, and reused while the source, options, devices and drivers match.
+  // Headless environments can split each device into sub-devices of a given
+  // number of compute units, which then stand in for the devices.
+  class ClEnvironment
+  {
+  public:
+    ClEnvironment(Framebuffer *_framebuffer = NULL, const std::string &_cache = "", const unsigned int _partition = 0);
+    ~ClEnvironment();
+
+    // Build a kernel file for every device, exiting with the build log on failure
+    cl_program build(const char _filepath[], const std::string &_options = "") const;
+
+    // Build source text generated at runtime in the same way, sharing the cache
+    cl_program buildSource(const std::string &_source, const std::string &_options = "") const;
+
+    cl_command_queue createQueue(const cl_command_queue_properties _properties = 0, const cl_uint _device = 0) const;
+
+    cl_context context() const;
+    cl_device_id device(const cl_uint _index = 0) const;
+    cl_uint deviceCount() const;
+
+  private:
+    void createContext(Framebuffer *_framebuffer);
+    void partitionDevices();
+
+    // Cache key text covering everything the binaries depend on
+    std::string cacheKey(const std::string &_source, const std::string &_options) const;
+
+    // Program from cached binaries, NULL if missing, stale or rejected by the driver
+    cl_program loadCached(const std::string &_filepath, const std::string &_key, const std::string &_options) const;
+    void storeCached(const std::string &_filepath, const std::string &_key, cl_program _program) const;
+
+  private:
+    std::string m_cache;
+    unsigned int m_partition;
+    cl_platform_id m_platform_id;
+    cl_uint m_device_count;
+    cl_device_id *m_device_ids;
+    cl_context m_context;
+  };
+
+#endif
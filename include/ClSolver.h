@@ -0,0 +1,210 @@
+#ifndef CL_SOLVER_H__
+  #define CL_SOLVER_H__
+
+  #include <PlatformSpecification.h>
+  #include <ClEnvironment.h>
+  #include <Framebuffer.h>
+  #include <Grid.h>
+  #include <InputData.h>
+  #include <Integrator.h>
+  #include <Options.h>
+  #include <Profiler.h>
+  #include <Solver.h>
+  #include <Storage.h>
+
+  // Planes of a volume each work-group of the volume kernel steps, the two
+  // halo planes it loads are shared by this many
+  #define VOLUME_SLAB 16
+
+  // Gray-Scott solver running on OpenCL devices. When a framebuffer is given
+  // the context is shared with its GL context so results can be drawn
+  // directly, otherwise no GL objects are touched and it can run headless.
+  class ClSolver : public Solver
+  {
+  public:
+    ClSolver(const Grid &_grid, const InputData &_input, const float *_a, const float *_b, const Options &_options, Framebuffer *_framebuffer = NULL);
+    ~ClSolver();
+
+    void step(const unsigned int _count);
+
+    // With a display queue the image is drawn from the latest steps on that
+    // queue, so the following steps run alongside it. Only the last of them
+    // that overwrites the displayed state waits on the colormap.
+    void present();
+
+    // Block until the last present released the image to GL, the sync point
+    // of the render loop before the frame is drawn
+    void waitPresent();
+    void read(float *_a, float *_b);
+    void finish();
+    unsigned int iteration() const;
+    void resume(const unsigned int _iteration);
+    void parameters(const InputData &_input);
+
+    // Copy the latest a and b into a device buffer of twice the field size on
+    // the compute queue, in the solver's storage and layout, signalling the event when done
+    void snapshot(cl_mem _fields, cl_event *_event);
+
+    const Grid& grid() const;
+    const ClEnvironment* environment() const;
+
+    // Time device commands into a profiler, which needs --profile for a
+    // profiling queue. The first launch of each call to step is sampled.
+    void profile(Profiler *_profiler);
+
+    // Format and arrangement of the device fields, snapshots are copied as they are
+    Storage storage() const;
+    Layout layout() const;
+
+    // Simulated time advanced since the solver was created and the current
+    // delta, which adaptive stepping changes every ADAPT_INTERVAL steps
+    double time() const;
+    float delta() const;
+
+    // Tiles stepped by the latest launches with --active-tiles, and tiles in the grid
+    unsigned int activeTiles() const;
+    unsigned int tiles() const;
+
+  private:
+    // Enqueue the next launch of up to _remaining steps, returning the steps it advances
+    unsigned int launch(const unsigned int _remaining, const bool _sampled);
+    void waitColormap();
+    void presentPipelined();
+    void launchStages(const bool _sampled);
+
+    // Measure the largest change of the last launch and adjust delta
+    void adapt(const unsigned int _steps);
+
+    // Upload the coefficients without waiting on the steps before, only
+    // waiting on the previous upload to have read its staging copy
+    void setInput();
+
+    // Map of (f, k) per cell of a plane from the ranges of the options, NULL without any
+    void createMap(const Options &_options);
+    void setMapArguments();
+    void checkStability() const;
+    float spectralRadius() const;
+
+    // Rebuild the list of tiles to step from those that changed in the last
+    // launch, or from every tile after the coefficients changed
+    void updateActive();
+    void activateAll();
+    void compactTiles();
+
+    void setArguments(cl_kernel _kernel, cl_mem _a_current, cl_mem _b_current, cl_mem _a_buffer, cl_mem _b_buffer);
+    void setupLocal(const Options &_options);
+    void setLocalArguments();
+
+    // Defines the program is built with, specializing it on the grid and coefficients if asked
+    std::string buildOptions() const;
+    void createKernels();
+    void releaseKernels();
+
+    // Event to time the next command with, NULL unless profiling
+    cl_event* event();
+    void profiled(const ProfileStage _stage, const unsigned int _steps = 1);
+
+  private:
+    Grid m_grid;
+    unsigned int m_iteration;
+    unsigned int m_source;
+    InputData m_input;
+    Storage m_storage;
+    Layout m_layout;
+
+    // What the program is specialized on, none, grid or all for grid and coefficients
+    std::string m_specialize;
+
+    ClEnvironment *m_environment;
+    cl_context m_context;
+    cl_device_id m_device;
+    cl_command_queue m_queue;
+    Profiler *m_profiler;
+
+    // Display queue of a pipelined solver, NULL otherwise. Markers bracket the
+    // latest steps on the compute queue. The colormap reads the state of
+    // m_presented_source and the release hands the image back to GL. The
+    // display span of the last present is kept to measure its overlap.
+    cl_command_queue m_display_queue;
+    cl_event m_step_begin;
+    cl_event m_stepped;
+    cl_event m_presented;
+    unsigned int m_presented_source;
+    cl_event m_released;
+    cl_event m_display_begin;
+    cl_event m_display_end;
+    cl_event m_event;
+    cl_program m_program;
+
+    cl_mem m_current_a, m_current_b;
+    cl_mem m_buffer_a, m_buffer_b;
+    cl_mem m_image;
+
+    // Coefficients read by the kernels from constant memory, updated from
+    // m_upload when they change, and the optional map of f and k per cell
+    cl_mem m_parameters;
+    InputData m_upload;
+    cl_event m_uploaded;
+    cl_mem m_map;
+    bool m_map_f;
+    bool m_map_k;
+
+    // Kernels indexed by the buffer holding the latest state, 0 reads current and writes buffer
+    cl_kernel m_simulate[2];
+    cl_kernel m_colormap[2];
+    cl_kernel m_tiled[2];
+    cl_kernel m_blocked[2];
+
+    // Runge-Kutta stage states, sum of the weighted stage rates and their kernels
+    Integrator m_integrator;
+    cl_mem m_stages[2];
+    cl_mem m_sum;
+    cl_kernel m_stage[2];
+
+    // Volumes of more than one plane are stepped with the 7 or 27-point
+    // stencil by their own kernel, the slice plane is the one displayed
+    bool m_use_volume;
+    int m_stencil;
+    int m_slice;
+    cl_kernel m_volume[2];
+    std::size_t m_volume_local[3];
+    std::size_t m_volume_global[3];
+
+    // Adaptive stepping, measuring the change of a launch into m_change
+    bool m_adaptive;
+    float m_adapt_target;
+    unsigned int m_since_adapt;
+    double m_time;
+    cl_mem m_change;
+    cl_kernel m_change_max;
+
+    // Active tiles, each the size of a work-group of the tiled kernel. The
+    // list is rebuilt every m_active_interval steps and holds m_active_count
+    // tiles, m_listed flagging which. Settled tiles are copied across the
+    // buffers by m_copy_settled when they may still differ between them.
+    bool m_active_tiles;
+    float m_active_threshold;
+    unsigned int m_active_interval;
+    unsigned int m_since_active;
+    cl_uint m_active_count;
+    cl_mem m_mask;
+    cl_mem m_tile_list;
+    cl_mem m_tile_count;
+    cl_mem m_listed;
+    cl_kernel m_active[2];
+    cl_kernel m_tile_activity;
+    cl_kernel m_compact_tiles;
+    cl_kernel m_copy_settled;
+
+    // Work-group size of the tiled kernels and their range rounded up to fit
+    bool m_use_tiled;
+    unsigned int m_block;
+    std::size_t m_local[2];
+    std::size_t m_global[2];
+
+    // Cells averaged along each axis per pixel of the displayed image and its size
+    int m_downsample;
+    std::size_t m_display[2];
+  };
+
+#endif
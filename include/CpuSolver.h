@@ -0,0 +1,83 @@
+#ifndef CPU_SOLVER_H__
+  #define CPU_SOLVER_H__
+
+  #include <Framebuffer.h>
+  #include <Grid.h>
+  #include <InputData.h>
+  #include <Solver.h>
+  #include <Storage.h>
+
+  #include <boost/thread.hpp>
+  #include <vector>
+
+  // Native Gray-Scott solver for machines without an OpenCL runtime. Rows are
+  // split across a pool of worker threads and each row is updated with the
+  // widest vector kernel the processor supports, chosen at runtime. With a
+  // 16-bit storage format rows are unpacked into a small window of fp32 rows
+  // per worker, updated by the same kernels and packed again on the way out.
+  // Interleaved fields have their own row kernels working on a/b pairs.
+  class CpuSolver : public Solver
+  {
+  public:
+    CpuSolver(const Grid &_grid, const InputData &_input, const float *_a, const float *_b, const unsigned int _threads = 0, const Storage _storage = STORAGE_FP32, const Layout _layout = LAYOUT_PLANAR, Framebuffer *_framebuffer = NULL, const unsigned int _downsample = 1);
+    ~CpuSolver();
+
+    void step(const unsigned int _count);
+    void present();
+    void read(float *_a, float *_b);
+    void finish();
+    unsigned int iteration() const;
+    void resume(const unsigned int _iteration);
+    void parameters(const InputData &_input);
+
+    // Name of the row kernel selected for this processor
+    const char* kernel() const;
+
+    // Force a row kernel by name (scalar, avx2, avx512), false if unsupported
+    bool selectKernel(const char *_name);
+
+    // Signature shared by the scalar and vectorized row kernels
+    typedef void (*RowKernel)(float *_a_out, float *_b_out, const float *_a_rows[3], const float *_b_rows[3], const int _width, const InputData &_input);
+    typedef void (*InterleavedRowKernel)(float *_out, const float *_rows[3], const int _width, const InputData &_input);
+
+    // Look up the row kernels of a name, false if this processor does not support them
+    static bool findKernel(const char *_name, RowKernel *_kernel, InterleavedRowKernel *_interleaved_kernel);
+
+  private:
+    void worker(const unsigned int _index);
+    void stepRows(const int _source, const int _begin, const int _end);
+    void stepPackedRows(const int _source, const int _begin, const int _end, float *_scratch);
+
+  private:
+    Grid m_grid;
+    unsigned int m_iteration;
+    InputData m_input;
+    Framebuffer *m_framebuffer;
+
+    // Cells averaged along each axis per pixel of the displayed image
+    int m_downsample;
+
+    // Double buffered padded fields in the storage format, index 0 holds the
+    // state after an even number of steps. Interleaved fields only use m_a.
+    Storage m_storage;
+    Layout m_layout;
+    void *m_a[2];
+    void *m_b[2];
+    std::vector<float> m_unpacked;
+    std::vector<float> m_image;
+
+    RowKernel m_kernel;
+    InterleavedRowKernel m_interleaved_kernel;
+    const char *m_kernel_name;
+
+    // Worker pool, the host joins the start and end barriers for each call to step
+    boost::thread_group m_threads;
+    boost::barrier *m_start;
+    boost::barrier *m_end;
+    boost::barrier *m_sync;
+    unsigned int m_thread_count;
+    unsigned int m_pending;
+    bool m_exit;
+  };
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef DISTRIBUTED_SOLVER_H__
+  #define DISTRIBUTED_SOLVER_H__
+
+  #include <CpuSolver.h>
+  #include <Grid.h>
+  #include <InputData.h>
+  #include <Solver.h>
+  #include <Transport.h>
+
+  // Rows of the interior computed between two calls to Transport::progress
+  #define PROGRESS_ROWS 64
+
+  // Gray-Scott solver for one rank of a distributed run. The toroidal grid is
+  // split into strips of whole rows, one per rank, each held with a halo row
+  // above and below. Every step the strip's first and last rows are computed
+  // first and sent to the neighbours, whose rows arrive in the new halos while
+  // the interior is computed. Fields are fp32 planar and rows are updated with
+  // the CPU backend's row kernels.
+  class DistributedSolver : public Solver
+  {
+  public:
+    DistributedSolver(const Grid &_grid, const InputData &_input, const float *_a, const float *_b, Transport *_transport);
+    ~DistributedSolver();
+
+    void step(const unsigned int _count);
+    void present();
+
+    // Only this rank's rows are written, at their place in the full fields
+    void read(float *_a, float *_b);
+    void finish();
+    unsigned int iteration() const;
+    void resume(const unsigned int _iteration);
+    void parameters(const InputData &_input);
+
+    // Rows of the full grid held by this rank
+    int row() const;
+    int rows() const;
+
+    // First of this rank's rows of the latest fields, padded to the grid stride
+    const float* a() const;
+    const float* b() const;
+
+    const char* kernel() const;
+
+  private:
+    void stepRows(const int _source, const int _begin, const int _end);
+
+  private:
+    Grid m_grid;
+    unsigned int m_iteration;
+    InputData m_input;
+    Transport *m_transport;
+    int m_row;
+    int m_rows;
+
+    // Double buffered strips with their halo rows, index 0 holds the state
+    // after an even number of steps
+    float *m_a[2];
+    float *m_b[2];
+
+    CpuSolver::RowKernel m_kernel;
+    const char *m_kernel_name;
+  };
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef FIELD_STREAM_H__
+  #define FIELD_STREAM_H__
+
+  #include <PlatformSpecification.h>
+  #include <ClEnvironment.h>
+  #include <ClSolver.h>
+  #include <Checkpoint.h>
+  #include <Grid.h>
+
+  #include <boost/thread.hpp>
+  #include <deque>
+  #include <string>
+  #include <vector>
+
+  // Streams snapshots of the fields to disk while the solver keeps running.
+  // Each snapshot is copied on the device into a free slot, read back on a
+  // separate transfer queue into pinned host memory, then written by a
+  // background thread straight from that memory. The compute queue never
+  // waits on a readback or on the disk. Checkpoints go through the same
+  // slots, so they are written without pausing the solver either.
+  class FieldStream
+  {
+  public:
+    FieldStream(ClSolver *_solver, const std::string &_prefix, const unsigned int _slots = 3);
+    ~FieldStream();
+
+    // Queue a snapshot of the solver's latest state, waiting only if every slot is still busy
+    void push();
+
+    // Queue a checkpoint of the solver's latest state, replacing the file once it is complete
+    void checkpoint(const std::string &_filepath, const InputData &_input, const unsigned int _seed);
+
+    // Block until every queued frame has been written
+    void flush();
+
+    unsigned int frames() const;
+    unsigned int stalls() const;
+
+  private:
+    struct Slot
+    {
+      cl_mem device;
+      cl_mem pinned;
+      char *host;
+      cl_event read;
+      unsigned int iteration;
+      bool busy;
+
+      // Set when the slot holds a checkpoint rather than a frame
+      bool checkpoint;
+      std::string filepath;
+      CheckpointHeader header;
+    };
+
+    // Snapshot the solver into the next free slot and hand it to the writer
+    void queue(const bool _checkpoint, const std::string &_filepath, const CheckpointHeader &_header);
+
+    void writer();
+    void write(const Slot &_slot, const float *_fields);
+
+  private:
+    ClSolver *m_solver;
+    Grid m_grid;
+    Storage m_storage;
+    Layout m_layout;
+    std::string m_prefix;
+    cl_command_queue m_transfer;
+    std::vector<Slot> m_slots;
+    unsigned int m_next;
+
+    // Slots waiting to be written, guarded by m_mutex
+    std::deque<std::size_t> m_pending;
+    boost::mutex m_mutex;
+    boost::condition_variable m_queued;
+    boost::condition_variable m_freed;
+    boost::thread m_thread;
+    bool m_exit;
+
+    // Fields in another format are converted here by the writer before going to disk
+    std::vector<float> m_unpacked;
+
+    unsigned int m_frames;
+    unsigned int m_stalls;
+  };
+
+#endif
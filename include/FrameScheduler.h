@@ -0,0 +1,31 @@
+#ifndef FRAME_SCHEDULER_H__
+  #define FRAME_SCHEDULER_H__
+
+  // Share of the frame budget the adaptive schedule fills with solver steps,
+  // leaving the rest for presenting the frame
+  #define SCHEDULER_FILL 0.8
+
+  // Upper bound on the steps run between two frames
+  #define SCHEDULER_MAX_STEPS (1u << 20)
+
+  // Decides how many solver steps to run between two displayed frames. A fixed
+  // count is used as given, otherwise the count adapts so that stepping fills
+  // most of the frame budget and the simulation runs at device speed.
+  class FrameScheduler
+  {
+  public:
+    FrameScheduler(const double _budget, const unsigned int _fixed = 0);
+
+    // Steps to run before the next frame
+    unsigned int steps() const;
+
+    // Time taken by the last frame's steps, used to adapt the next count
+    void record(const unsigned int _steps, const double _seconds);
+
+  private:
+    double m_budget;
+    bool m_adaptive;
+    unsigned int m_steps;
+  };
+
+#endif
@@ -7,11 +7,13 @@
 	class Framebuffer
 	{
 	public:
-		Framebuffer()
+		Framebuffer(const int _texture_x, const int _texture_y)
       : m_update(true)
       , m_pan(false)
-      , m_res_x(700.f)
-      , m_res_y(500.f)
+      , m_res_x(_texture_x)
+      , m_res_y(_texture_y)
+      , m_tex_x(_texture_x)
+      , m_tex_y(_texture_y)
       , m_screen_x(0.f)
       , m_screen_y(0.f)
       , m_state_x(0.f)
@@ -54,6 +56,7 @@
     bool m_update;
     bool m_pan;
     float m_res_x, m_res_y;
+    int m_tex_x, m_tex_y;
     float m_screen_x, m_screen_y;
     float m_state_x, m_state_y;
     float m_trans_x, m_trans_y;
@@ -0,0 +1,50 @@
+#ifndef GRID_H__
+  #define GRID_H__
+
+  #include <cstddef>
+
+  // Rows are padded to a multiple of this many floats, one AVX-512 vector or 64 bytes
+  #define GRID_ALIGNMENT 16
+
+  // Dimensions of the simulation domain. Fields are stored row-major with
+  // stride floats per row, of which only the first width are cells. Volumes
+  // stack depth planes of height rows each, a plane is a 2D field.
+  struct Grid
+  {
+    Grid(const int _width = 700, const int _height = 500, const int _depth = 1)
+      : width(_width)
+      , height(_height)
+      , depth(_depth)
+      , stride(((_width + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT) * GRID_ALIGNMENT)
+    {;}
+
+    // Number of floats in a field including the row padding
+    std::size_t size() const
+    {
+      return plane() * depth;
+    }
+
+    // Number of floats in one plane of a volume, the whole field in 2D
+    std::size_t plane() const
+    {
+      return static_cast<std::size_t>(stride) * height;
+    }
+
+    // Rows of every plane, which follow each other in memory
+    int rows() const
+    {
+      return height * depth;
+    }
+
+    std::size_t cells() const
+    {
+      return static_cast<std::size_t>(width) * height * depth;
+    }
+
+    int width;
+    int height;
+    int depth;
+    int stride;
+  };
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef INPUT_DATA_H__
+  #define INPUT_DATA_H__
+
+  // Gray-Scott coefficients, mirrored by the struct in kernels/image.cl
+  struct InputData
+  {
+    float Da;
+    float Db;
+    float f;
+    float k;
+    float delta;
+  };
+
+#endif
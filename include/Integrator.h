@@ -0,0 +1,53 @@
+#ifndef INTEGRATOR_H__
+  #define INTEGRATOR_H__
+
+  #include <InputData.h>
+  #include <string>
+
+  // Largest magnitude of the eigenvalues of the 9-point stencil, reached by a
+  // checkerboard: -1 - 4 * 0.2 + 4 * 0.05
+  #define STENCIL_SPECTRAL_RADIUS 1.6f
+
+  // The same for the volume stencils, -1 - 6 / 6 for the 7-point one and
+  // -1 - 16 / 88 from the corners of the 27-point one
+  #define VOLUME_7_SPECTRAL_RADIUS 2.f
+  #define VOLUME_27_SPECTRAL_RADIUS (13.f / 11.f)
+
+  // Fraction of the stability bound adaptive stepping stays under, the
+  // reaction terms are left out of the bound
+  #define ADAPT_SAFETY 0.9f
+
+  // Steps between two measurements of the change per step
+  #define ADAPT_INTERVAL 16
+
+  // Limits on how much delta may change in one adjustment
+  #define ADAPT_GROWTH 2.f
+  #define ADAPT_SHRINK 0.5f
+
+  // Explicit time integrator of the solver steps
+  enum Integrator
+  {
+    INTEGRATOR_EULER,
+    INTEGRATOR_RK2,
+    INTEGRATOR_RK4
+  };
+
+  // Integrator named on the command line, euler, rk2 or rk4
+  Integrator integrator_from_name(const std::string &_name);
+  const char* integrator_name(const Integrator _integrator);
+
+  // Stages per step, each stage's weight in the step and the fraction of
+  // delta the following stage is evaluated at
+  int integrator_stages(const Integrator _integrator);
+  float stage_weight(const Integrator _integrator, const int _stage);
+  float stage_scale(const Integrator _integrator, const int _stage);
+
+  // Largest delta for which diffusion with these coefficients stays stable
+  // under a stencil of the given spectral radius
+  float stable_delta(const InputData &_input, const Integrator _integrator, const float _radius = STENCIL_SPECTRAL_RADIUS);
+
+  // Delta giving a largest change per step near the target, from the change
+  // measured at the current delta, within the limit
+  float adapt_delta(const float _delta, const float _change, const float _target, const float _limit);
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef MODEL_H__
+  #define MODEL_H__
+
+  #include <string>
+  #include <vector>
+
+  // Cells of a row evaluated together by each instruction of a model program
+  #define MODEL_CHUNK 64
+
+  // Operations of a model program. Every instruction works on MODEL_CHUNK
+  // values at once, so the interpreter's overhead is spread over a chunk and
+  // its loops can be vectorized.
+  enum ModelOp
+  {
+    OP_CONSTANT,
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_NEGATE,
+    OP_EXP,
+    OP_SQRT,
+    OP_ABS,
+    OP_POW,
+    OP_MIN,
+    OP_MAX
+  };
+
+  // Writes register target from registers left and right, or from value for constants
+  struct ModelInstruction
+  {
+    ModelOp op;
+    int target;
+    int left;
+    int right;
+    float value;
+  };
+
+  // Reaction-diffusion model read from a description file of one statement per line:
+  //
+  //   species u v                 names of the fields, in order
+  //   diffusion u 1.0             diffusion coefficient, 0 by default
+  //   parameter a 0.7             constant usable in reactions
+  //   reaction u u - u*u*u/3 - v  reaction term, 0 by default
+  //   initial u 0                 value everywhere at the start, 0 by default
+  //   seeded u 1                  value where the initial pattern is seeded
+  //   delta 0.1                   time step, 1 by default
+  //
+  // Reactions are expressions of species, parameters and numbers with + - * /,
+  // parentheses and the functions exp, sqrt, abs, pow, min and max. Each
+  // species changes by delta * (diffusion * laplacian + reaction) per step, the
+  // laplacian term leading the sum of the reaction's top-level terms in the
+  // order they are written. The model is compiled into OpenCL source with every
+  // coefficient folded in, and into a program for the CPU interpreter.
+  class Model
+  {
+  public:
+    // Exits with the line at fault if the description is invalid
+    explicit Model(const std::string &_filepath);
+
+    const std::string& name() const;
+    int species() const;
+    const std::string& speciesName(const int _species) const;
+    float initial(const int _species) const;
+    float seeded(const int _species) const;
+    float delta() const;
+
+    // Defines MODEL_SPECIES and a function model_update(float *c, const float *l)
+    // stepping the cell values c given their laplacians l, to be built before kernels/model.cl
+    std::string openclSource() const;
+
+    // Instructions computing the next value of each species with the same
+    // operations in the same order as the OpenCL source. Registers 0 to
+    // species - 1 hold the cells, the next species registers their laplacians.
+    const std::vector<ModelInstruction>& program() const;
+    int registers() const;
+    int nextRegister(const int _species) const;
+
+    // Run the program over _count cells, at most MODEL_CHUNK. Inputs point at
+    // the cells and laplacians of each species, scratch holds scratchFloats()
+    // floats and registers receives where each register's values are.
+    void evaluate(const float *const *_inputs, float *_scratch, const int _count, const float **_registers) const;
+    std::size_t scratchFloats() const;
+
+  private:
+    // Expression tree, children index m_nodes
+    enum NodeKind
+    {
+      NODE_NUMBER,
+      NODE_SPECIES,
+      NODE_BINARY,
+      NODE_NEGATE,
+      NODE_CALL
+    };
+
+    struct Node
+    {
+      NodeKind kind;
+      float value;
+      int species;
+      std::string name;
+      char op;
+      int left;
+      int right;
+    };
+
+    void parseStatement(const std::string &_line, const int _number);
+    int speciesIndex(const std::string &_name, const int _line) const;
+    void fail(const int _line, const std::string &_message) const;
+
+    // Recursive descent over the text of one reaction
+    int parseSum(const std::string &_text, std::size_t &_position, const int _line);
+    int parseProduct(const std::string &_text, std::size_t &_position, const int _line);
+    int parseUnary(const std::string &_text, std::size_t &_position, const int _line);
+    int parsePrimary(const std::string &_text, std::size_t &_position, const int _line);
+    int addNode(const Node &_node);
+
+    // Terms of a rate as signs and nodes, the laplacian term first
+    void rateTerms(const int _species, std::vector<char> *_signs, std::vector<int> *_nodes) const;
+    void flatten(const int _node, const char _sign, std::vector<char> *_signs, std::vector<int> *_nodes) const;
+
+    std::string emit(const int _node) const;
+    int compile(const int _node);
+    int instruction(const ModelOp _op, const int _left, const int _right, const float _value);
+    void compileUpdates();
+
+  private:
+    std::string m_filepath;
+    std::string m_name;
+    std::vector<std::string> m_species;
+    std::vector<float> m_diffusion;
+    std::vector<float> m_initial;
+    std::vector<float> m_seeded;
+
+    // Reactions as written and where, parsed into root nodes once every parameter is known
+    std::vector<std::string> m_reaction_text;
+    std::vector<int> m_reaction_line;
+    std::vector<int> m_reaction;
+    std::vector<std::string> m_parameters;
+    std::vector<float> m_values;
+    float m_delta;
+
+    std::vector<Node> m_nodes;
+    std::vector<ModelInstruction> m_program;
+    std::vector<int> m_next;
+    int m_registers;
+  };
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef MODEL_CL_SOLVER_H__
+  #define MODEL_CL_SOLVER_H__
+
+  #include <PlatformSpecification.h>
+  #include <ClEnvironment.h>
+  #include <Grid.h>
+  #include <Model.h>
+  #include <ModelSolver.h>
+  #include <Options.h>
+
+  // Generated model running on an OpenCL device. The program is built from the
+  // model's source with its coefficients and the grid folded in, and steps
+  // every species of a tile together with the tiled kernel of kernels/model.cl.
+  class ModelClSolver : public ModelSolver
+  {
+  public:
+    // Fields hold the padded field of each species one after the other
+    ModelClSolver(const Grid &_grid, const Model &_model, const float *_fields, const Options &_options);
+    ~ModelClSolver();
+
+    void step(const unsigned int _count);
+    void read(const int _species, float *_field);
+    void finish();
+    unsigned int iteration() const;
+
+  private:
+    Grid m_grid;
+    int m_species;
+    unsigned int m_iteration;
+
+    ClEnvironment *m_environment;
+    cl_command_queue m_queue;
+    cl_program m_program;
+
+    // Species planes, index 0 holds the state after an even number of steps
+    cl_mem m_fields[2];
+
+    // Kernels indexed by the buffer they read from
+    cl_kernel m_kernels[2];
+
+    std::size_t m_local[2];
+    std::size_t m_global[2];
+  };
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef MODEL_CPU_SOLVER_H__
+  #define MODEL_CPU_SOLVER_H__
+
+  #include <Grid.h>
+  #include <Model.h>
+  #include <ModelSolver.h>
+
+  #include <boost/thread.hpp>
+
+  // Generated model stepped natively by interpreting its program. Rows are
+  // split across a pool of worker threads, each evaluating MODEL_CHUNK cells
+  // per instruction with the same operations as the OpenCL source.
+  class ModelCpuSolver : public ModelSolver
+  {
+  public:
+    // Fields hold the padded field of each species one after the other
+    ModelCpuSolver(const Grid &_grid, const Model &_model, const float *_fields, const unsigned int _threads = 0);
+    ~ModelCpuSolver();
+
+    void step(const unsigned int _count);
+    void read(const int _species, float *_field);
+    void finish();
+    unsigned int iteration() const;
+
+  private:
+    void worker(const unsigned int _index);
+    void stepRows(const int _source, const int _begin, const int _end, float *_scratch, const float **_registers);
+
+  private:
+    Grid m_grid;
+    Model m_model;
+    unsigned int m_iteration;
+
+    // Double buffered species planes, index 0 holds the state after an even number of steps
+    float *m_fields[2];
+
+    // Worker pool, the host joins the start and end barriers for each call to step
+    boost::thread_group m_threads;
+    boost::barrier *m_start;
+    boost::barrier *m_end;
+    boost::barrier *m_sync;
+    unsigned int m_thread_count;
+    unsigned int m_pending;
+    bool m_exit;
+  };
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef MODEL_SOLVER_H__
+  #define MODEL_SOLVER_H__
+
+  // Common interface for the backends stepping a generated model. Models run
+  // headless only and keep every species as a padded field of its own.
+  class ModelSolver
+  {
+  public:
+    virtual ~ModelSolver() {;}
+
+    virtual void step(const unsigned int _count) = 0;
+
+    // Copy the latest field of one species into host memory
+    virtual void read(const int _species, float *_field) = 0;
+
+    // Block until all submitted work has completed
+    virtual void finish() = 0;
+
+    virtual unsigned int iteration() const = 0;
+  };
+
+#endif
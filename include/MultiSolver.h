@@ -0,0 +1,82 @@
+#ifndef MULTI_SOLVER_H__
+  #define MULTI_SOLVER_H__
+
+  #include <PlatformSpecification.h>
+  #include <ClEnvironment.h>
+  #include <Grid.h>
+  #include <InputData.h>
+  #include <Options.h>
+  #include <Solver.h>
+  #include <Storage.h>
+
+  #include <vector>
+
+  // Gray-Scott solver splitting the domain into strips of rows, one per
+  // OpenCL device or sub-device, each with its own queue. Strips carry halo
+  // rows from their neighbours that are exchanged every halo steps, the strip
+  // recomputing its shrinking halo in between. The rows neighbours need are
+  // computed first and copied on a separate transfer queue while the rest of
+  // the strip is computed. Headless only, nothing is drawn.
+  class MultiSolver : public Solver
+  {
+  public:
+    MultiSolver(const Grid &_grid, const InputData &_input, const float *_a, const float *_b, const Options &_options);
+    ~MultiSolver();
+
+    void step(const unsigned int _count);
+    void present();
+    void read(float *_a, float *_b);
+    void finish();
+    unsigned int iteration() const;
+    void resume(const unsigned int _iteration);
+    void parameters(const InputData &_input);
+
+    unsigned int devices() const;
+
+  private:
+    // Rows of the domain held by one device, with halo rows above and below
+    struct Strip
+    {
+      cl_command_queue queue;
+      cl_command_queue transfer;
+      int row;
+      int rows;
+
+      // Fields indexed by parity, b aliases a when interleaved
+      cl_mem a[2];
+      cl_mem b[2];
+
+      // Kernels indexed by the parity they read from
+      cl_kernel kernels[2];
+
+      // Latest copies into the top and bottom halos
+      cl_event copies[2];
+    };
+
+    // Advance every strip by up to halo steps and exchange the halos
+    void period(const unsigned int _steps);
+    void launch(Strip &_strip, const int _source, const int _begin, const int _end, const std::vector<cl_event> &_wait, cl_event *_event);
+    void copyHalo(Strip &_strip, const int _side, const Strip &_from, const int _from_row, const int _to_row, const int _parity, const cl_event _wait[2]);
+
+    // Copies of the last exchange touching a strip's buffers, which its next launch waits on
+    std::vector<cl_event> dependencies(const std::size_t _index) const;
+
+  private:
+    Grid m_grid;
+    unsigned int m_iteration;
+    unsigned int m_halo;
+    int m_parity;
+    InputData m_input;
+    Storage m_storage;
+    Layout m_layout;
+
+    // Bytes per row of each field buffer and the number of distinct buffers per field set
+    std::size_t m_row_bytes;
+    int m_planes;
+
+    ClEnvironment *m_environment;
+    cl_program m_program;
+    std::vector<Strip> m_strips;
+  };
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef OPTIONS_H__
+  #define OPTIONS_H__
+
+  #include <string>
+
+  // Command line options controlling how the simulation is run
+  struct Options
+  {
+    Options()
+      : headless(false)
+      , steps(10000)
+      , output("output")
+      , width(700)
+      , height(500)
+      , depth(1)
+      , stencil(7)
+      , slice(-1)
+      , backend("opencl")
+      , threads(0)
+      , halo(1)
+      , partition(0)
+      , ranks(0)
+      , compare(false)
+      , kernel("tiled")
+      , kernel_cache("kernel-cache")
+      , specialize("grid")
+      , storage("fp32")
+      , storage_report(false)
+      , layout("planar")
+      , local_x(16)
+      , local_y(16)
+      , block(1)
+      , integrator("euler")
+      , adaptive(false)
+      , adapt_target(0.01f)
+      , time(0.0)
+      , active_tiles(false)
+      , active_threshold(0.f)
+      , sweep(false)
+      , stream(0)
+      , stream_slots(3)
+      , checkpoint(0)
+      , seed(0)
+      , init("noise")
+      , spots(16)
+      , spot_radius(8)
+      , steps_per_frame(0)
+      , downsample(0)
+      , pipeline(false)
+      , profile(false)
+      , bench(false)
+      , bench_sizes("256x256,1024x1024,4096x4096")
+      , bench_local("8x8,16x16,32x8")
+      , bench_layouts("planar,interleaved")
+      , bench_backends("opencl,cpu")
+      , bench_steps(100)
+      , bench_repeats(5)
+    {;}
+
+    bool headless;
+    unsigned int steps;
+    std::string output;
+    int width;
+    int height;
+
+    // Planes of a volume, 1 for a 2D grid, the points of its Laplacian
+    // stencil, 7 or 27, and the plane shown by the preview, -1 for the middle
+    int depth;
+    int stencil;
+    int slice;
+    std::string backend;
+    unsigned int threads;
+
+    // Rows exchanged between strips of the multi backend, also the steps between exchanges
+    unsigned int halo;
+
+    // Split each OpenCL device into sub-devices of this many compute units when non-zero
+    unsigned int partition;
+
+    // Local processes a headless run is distributed over when non-zero
+    unsigned int ranks;
+
+    bool compare;
+    std::string kernel;
+
+    // Directory of cached program binaries, empty to always build from source
+    std::string kernel_cache;
+
+    // Constants the OpenCL program is built for, none, grid or all for grid and coefficients
+    std::string specialize;
+
+    // Format of the a and b fields between steps, fp32, half or bf16
+    std::string storage;
+    bool storage_report;
+
+    // Arrangement of the a and b fields, planar or interleaved
+    std::string layout;
+    unsigned int local_x;
+    unsigned int local_y;
+    unsigned int block;
+
+    // Time integrator of the OpenCL steps, euler, rk2 or rk4
+    std::string integrator;
+
+    // Adapt delta towards a largest change per step of adapt_target, within the stability bound
+    bool adaptive;
+    float adapt_target;
+
+    // Simulated time a headless run advances when non-zero, instead of a number of steps
+    double time;
+
+    // Only step tiles near those whose largest change per step is above active_threshold
+    bool active_tiles;
+    float active_threshold;
+
+    // Ranges as from:to of the maps giving each cell its own f, ramped down
+    // the rows, and k, ramped across the columns. Empty keeps the coefficient uniform.
+    std::string map_f;
+    std::string map_k;
+
+    // Parameter sweep ranges as min:max:count or a single value, empty keeps the default
+    bool sweep;
+    std::string sweep_Da;
+    std::string sweep_Db;
+    std::string sweep_f;
+    std::string sweep_k;
+
+    // Write a frame every stream steps when non-zero, through stream_slots staging buffers
+    unsigned int stream;
+    unsigned int stream_slots;
+
+    // Write a checkpoint every checkpoint steps when non-zero, restart resumes from one
+    unsigned int checkpoint;
+    std::string restart;
+
+    // Seed of the initial pattern, 0 picks one from the clock
+    unsigned int seed;
+
+    // Initial pattern of b, noise, spots or mask, with the number and radius
+    // of the spots and the PGM image of the mask
+    std::string init;
+    unsigned int spots;
+    int spot_radius;
+    std::string mask;
+
+    // Model description file run instead of the built-in Gray-Scott solver, empty for none
+    std::string model;
+
+    // Solver steps between displayed frames, 0 adapts to fill the frame time
+    unsigned int steps_per_frame;
+
+    // Cells averaged along each axis per displayed pixel, 0 picks the smallest
+    // factor that fits the window
+    unsigned int downsample;
+
+    // Present each frame on a display queue of its own while the next frame's steps run
+    bool pipeline;
+
+    // Time device commands and frame stages, reporting rolling percentiles
+    bool profile;
+
+    // Benchmark matrix as comma separated lists, every combination is timed
+    // over bench_repeats runs of bench_steps steps
+    bool bench;
+    std::string bench_sizes;
+    std::string bench_local;
+    std::string bench_layouts;
+    std::string bench_backends;
+    unsigned int bench_steps;
+    unsigned int bench_repeats;
+  };
+
+  Options parse_options(int argc, char const *argv[]);
+
+#endif
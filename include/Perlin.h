@@ -11,17 +11,29 @@
 #ifndef _PERLIN_H_
 #define _PERLIN_H_
 
+#include <random>
+
 
 class Perlin {
 public:
 	Perlin();
+	// Seeds the permutation and gradient tables so that the noise is reproducible.
+	// The tables come from std::mt19937, which gives the same sequence on every platform.
+	Perlin(unsigned int seed);
 	~Perlin();
 
 	// Generates a Perlin (smoothed) noise value between -1 and 1, at the given 3D position.
-	float noise(float sample_x, float sample_y, float sample_z);
+	float noise(float sample_x, float sample_y, float sample_z) const;
+
+	// Generates noise(x / scale, sample_y, sample_z) for x from begin to end - 1 into out.
+	// The table lookups are made once per unit cube crossed, leaving a loop of plain
+	// arithmetic the compiler can vectorize. Values are bitwise identical to noise().
+	void noiseRow(int begin, int end, float scale, float sample_y, float sample_z, float *out) const;
 
 
 private:
+	void init(std::mt19937 &generator);
+
 	int *p; // Permutation table
 	// Gradient vectors
 	float *Gx;
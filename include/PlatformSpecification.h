@@ -8,13 +8,16 @@
     #include <GLFW/glfw3.h>
   #elif __linux__
     #include <CL/cl.h>
+    #include <CL/cl_gl.h>
     #include <GL/gl.h>
     #define USING_GLEW
     #define GLEW_STATIC
     #include <GL/glew.h>
     #include <GLFW/glfw3.h>
+    #include <GL/glx.h>
   #elif _WIN32
     #include <CL/cl.h>
+    #include <CL/cl_gl.h>
     #include <GL/gl.h>
     #define USING_GLEW
     #define GLEW_STATIC
@@ -0,0 +1,75 @@
+#ifndef PROFILER_H__
+  #define PROFILER_H__
+
+  #include <PlatformSpecification.h>
+
+  #include <ostream>
+  #include <vector>
+
+  // Samples kept per stage, percentiles cover the most recent ones
+  #define PROFILER_SAMPLES 256
+
+  // Stages timed by the profiler. Device stages are taken from OpenCL event
+  // profiling, the draw and frame stages are host times around the render loop.
+  // The overlap is the device time two queues spent running at once.
+  enum ProfileStage
+  {
+    PROFILE_STEP,
+    PROFILE_ACQUIRE,
+    PROFILE_COLORMAP,
+    PROFILE_RELEASE,
+    PROFILE_READ,
+    PROFILE_DRAW,
+    PROFILE_FRAME,
+    PROFILE_OVERLAP,
+    PROFILE_STAGES
+  };
+
+  const char* profile_stage_name(const ProfileStage _stage);
+
+  // Rolling timings per stage in a ring buffer of the latest samples. Events
+  // handed over are resolved once complete, so recording never blocks a queue.
+  class Profiler
+  {
+  public:
+    Profiler();
+    ~Profiler();
+
+    // Host time of a stage in milliseconds
+    void record(const ProfileStage _stage, const double _milliseconds);
+
+    // Event of a command on a queue created with CL_QUEUE_PROFILING_ENABLE,
+    // released once read. Commands covering several steps give the time per step.
+    void record(const ProfileStage _stage, cl_event _event, const unsigned int _steps = 1);
+
+    // Spans of commands on two queues, each from the start of its first event
+    // to the end of its last, recorded as the time they overlap. The events
+    // need profiling queues and are released once read.
+    void overlap(cl_event _first_begin, cl_event _first_end, cl_event _second_begin, cl_event _second_end);
+
+    // Read the timings of every completed event
+    void collect();
+
+    // Percentile in [0, 100] of the stage's recent samples in milliseconds, 0 without samples
+    double percentile(const ProfileStage _stage, const double _percent) const;
+
+    // Table of the sample count, mean and percentiles of every stage with samples
+    void dump(std::ostream &_stream) const;
+
+  private:
+    struct Pending
+    {
+      ProfileStage stage;
+      cl_event event;
+      unsigned int steps;
+    };
+
+    std::vector<double> m_samples[PROFILE_STAGES];
+    std::size_t m_next[PROFILE_STAGES];
+    std::vector<Pending> m_pending;
+
+    // Begin and end events of both spans of each pending overlap
+    std::vector<cl_event> m_overlaps;
+  };
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef SEEDING_H__
+  #define SEEDING_H__
+
+  #include <Grid.h>
+  #include <Options.h>
+  #include <string>
+
+  // Cells per unit of the noise lattice and the noise level above which b is seeded
+  #define NOISE_SCALE 100.f
+  #define NOISE_THRESHOLD 0.4f
+
+  // Pattern of b a run starts from, a starts at 1 everywhere. Noise seeds b
+  // where Perlin noise is above NOISE_THRESHOLD, spots seeds discs at random
+  // places and mask seeds b where a greyscale image is bright. Volumes are
+  // seeded from 3D noise and balls, and the mask is repeated on every plane.
+  enum SeedPattern
+  {
+    SEED_NOISE,
+    SEED_SPOTS,
+    SEED_MASK
+  };
+
+  // Pattern named on the command line, noise, spots or mask
+  SeedPattern seed_pattern_from_name(const std::string &_name);
+  const char* seed_pattern_name(const SeedPattern _pattern);
+
+  // Fill the padded a and b fields with the initial state for a seed. Rows are
+  // split over _options.threads threads, or every core when 0, and every value
+  // depends only on the seed and its cell, so the fields are bitwise identical
+  // whatever the number of threads.
+  void seed_fields(const Options &_options, const unsigned int _seed, const Grid &_grid, float *_a, float *_b);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef SOLVER_H__
+  #define SOLVER_H__
+
+  #include <InputData.h>
+
+  // Common interface for the Gray-Scott backends so they can be chosen at runtime
+  class Solver
+  {
+  public:
+    virtual ~Solver() {;}
+
+    // Advance the simulation without updating any display
+    virtual void step(const unsigned int _count) = 0;
+
+    // Write the latest a field into the framebuffer's texture without stepping
+    virtual void present() = 0;
+
+    // Copy the latest a and b fields into host memory
+    virtual void read(float *_a, float *_b) = 0;
+
+    // Block until all submitted work has completed
+    virtual void finish() = 0;
+
+    virtual unsigned int iteration() const = 0;
+
+    // Continue counting from a restored iteration, the fields are left as they are
+    virtual void resume(const unsigned int _iteration) = 0;
+
+    // Coefficients used by the following steps
+    virtual void parameters(const InputData &_input) = 0;
+  };
+
+#endif
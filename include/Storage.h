@@ -0,0 +1,56 @@
+#ifndef STORAGE_H__
+  #define STORAGE_H__
+
+  #include <boost/cstdint.hpp>
+  #include <cstddef>
+  #include <string>
+
+  // Format the a and b fields are held in between steps. Arithmetic is always
+  // done in fp32, the 16-bit formats only halve the memory and the traffic.
+  enum Storage
+  {
+    STORAGE_FP32,
+    STORAGE_HALF,
+    STORAGE_BF16
+  };
+
+  // Storage named on the command line, fp32, half or bf16
+  Storage storage_from_name(const std::string &_name);
+  const char* storage_name(const Storage _storage);
+
+  // Bytes per cell and the define selecting the format in kernels/image.cl
+  std::size_t storage_bytes(const Storage _storage);
+  std::string storage_define(const Storage _storage);
+
+  // Conversions rounding to nearest even, matching vstore_half_rte and the bf16 kernels
+  boost::uint16_t float_to_half(const float _value);
+  float half_to_float(const boost::uint16_t _value);
+  boost::uint16_t float_to_bf16(const float _value);
+  float bf16_to_float(const boost::uint16_t _value);
+
+  // Convert a run of values between fp32 and the storage format
+  void pack_values(const Storage _storage, const float *_in, void *_out, const std::size_t _count);
+  void unpack_values(const Storage _storage, const void *_in, float *_out, const std::size_t _count);
+
+  // Arrangement of the a and b fields. Planar fields are separate arrays,
+  // interleaved fields hold a and b of each cell side by side in one array.
+  enum Layout
+  {
+    LAYOUT_PLANAR,
+    LAYOUT_INTERLEAVED
+  };
+
+  // Layout named on the command line, planar or interleaved
+  Layout layout_from_name(const std::string &_name);
+  std::string layout_define(const Layout _layout);
+
+  // Convert count cells between planar and interleaved fields
+  void interleave_fields(const float *_a, const float *_b, float *_out, const std::size_t _count);
+  void deinterleave_fields(const float *_in, float *_a, float *_b, const std::size_t _count);
+
+  // Convert planar fp32 a and b to both fields as held on a device, and back.
+  // Planar fields are stored a then b, interleaved fields as one array.
+  void pack_fields(const Storage _storage, const Layout _layout, const float *_a, const float *_b, void *_out, const std::size_t _count);
+  void unpack_fields(const Storage _storage, const Layout _layout, const void *_in, float *_a, float *_b, const std::size_t _count);
+
+#endif
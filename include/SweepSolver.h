@@ -0,0 +1,46 @@
+#ifndef SWEEP_SOLVER_H__
+  #define SWEEP_SOLVER_H__
+
+  #include <PlatformSpecification.h>
+  #include <ClEnvironment.h>
+  #include <Grid.h>
+  #include <InputData.h>
+  #include <vector>
+
+  // Runs many small independent simulations with different coefficients in a
+  // single batched launch per step. Every instance starts from the same state
+  // and all of them advance in lockstep.
+  class SweepSolver
+  {
+  public:
+    SweepSolver(const Grid &_grid, const std::vector<InputData> &_inputs, const float *_a, const float *_b, const std::string &_cache = "");
+    ~SweepSolver();
+
+    void step(const unsigned int _count);
+
+    // Copy the latest padded fields of one instance into host memory
+    void read(const unsigned int _instance, float *_a, float *_b);
+    void finish();
+
+    unsigned int instances() const;
+    unsigned int iteration() const;
+
+  private:
+    Grid m_grid;
+    unsigned int m_instances;
+    unsigned int m_iteration;
+
+    ClEnvironment *m_environment;
+    cl_command_queue m_queue;
+    cl_program m_program;
+
+    // Stacked fields of every instance and their coefficients
+    cl_mem m_a[2];
+    cl_mem m_b[2];
+    cl_mem m_inputs;
+
+    // Kernels indexed by the buffer they read from
+    cl_kernel m_kernels[2];
+  };
+
+#endif
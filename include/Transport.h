@@ -0,0 +1,64 @@
+#ifndef TRANSPORT_H__
+  #define TRANSPORT_H__
+
+  #include <cstddef>
+  #include <deque>
+  #include <vector>
+
+  // Links of a rank to its neighbours in the ring
+  #define LINK_UP 0
+  #define LINK_DOWN 1
+
+  // Point to point messages between ranks arranged in a ring, a local stand-in
+  // for MPI. Ranks are processes forked on this machine and every neighbouring
+  // pair is connected by a Unix stream socket. Sends and receives are
+  // nonblocking: they are only queued, and are moved along by progress() and
+  // completed by wait(), so computation can continue while messages are in
+  // flight. Messages on a link arrive in the order they were sent.
+  class Transport
+  {
+  public:
+    // Fork _size - 1 further ranks, every process returns with its own transport
+    static Transport* spawn(const unsigned int _size);
+
+    // Rank 0 waits for the other ranks to exit
+    ~Transport();
+
+    int rank() const;
+    int size() const;
+
+    // Queue a message, the buffer must stay untouched until wait() returns
+    void isend(const int _link, const void *_data, const std::size_t _bytes);
+    void irecv(const int _link, void *_data, const std::size_t _bytes);
+
+    // Move queued messages as far as possible without blocking
+    void progress();
+
+    // Block until every queued message has completed
+    void wait();
+
+    // No rank leaves the barrier before every rank has reached it
+    void barrier();
+
+  private:
+    Transport(const int _rank, const int _size, const int _up, const int _down);
+
+    bool pending() const;
+
+  private:
+    // Part of a buffer still to be sent or received
+    struct Message
+    {
+      char *data;
+      std::size_t bytes;
+    };
+
+    int m_rank;
+    int m_size;
+    int m_links[2];
+    std::deque<Message> m_sends[2];
+    std::deque<Message> m_receives[2];
+    std::vector<int> m_children;
+  };
+
+#endif
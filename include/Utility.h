@@ -0,0 +1,30 @@
+#ifndef UTILITY_H__
+  #define UTILITY_H__
+
+  #include <PlatformSpecification.h>
+  #include <Grid.h>
+  #include <string>
+
+  // Read file function to load source for runtime kernel compilation
+  std::string read_file(const char _filepath[]);
+
+  // Write a raw float field to disk in row-major order without row padding,
+  // the planes of a volume one after the other
+  void write_field(const std::string &_filepath, const float *_data, const Grid &_grid);
+
+  // Write _rows rows starting at row _row into an existing raw field file, so
+  // that several processes can each write their own rows of one field
+  void write_field_rows(const std::string &_filepath, const float *_data, const Grid &_grid, const int _row, const int _rows);
+
+  // Allocate a padded field aligned to GRID_ALIGNMENT floats, released with free_field
+  float* allocate_field(const Grid &_grid);
+  void free_field(float *_field);
+
+  // Allocate memory aligned like a field, for fields held in other formats
+  void* allocate_aligned(const std::size_t _bytes);
+  void free_aligned(void *_memory);
+
+  // Function to check OpenCL error codes
+  void opencl_error_check(const cl_int _error);
+
+#endif
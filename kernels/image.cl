@@ -7,6 +7,109 @@ struct InputData
   float delta;
 };
 
+// Storage of the a and b fields, chosen with a define when the program is
+// built. Values are always computed in fp32, the 16-bit formats only halve
+// the memory used and the traffic per step.
+#if defined(STORAGE_HALF)
+  #define FIELD half
+  #define LOAD(_array, _i) vload_half((_i), (_array))
+  #define STORE(_array, _i, _value) vstore_half_rte((_value), (_i), (_array))
+  #define LOAD2(_array, _i) vload_half2((_i), (_array))
+  #define STORE2(_array, _i, _value) vstore_half2_rte((_value), (_i), (_array))
+#elif defined(STORAGE_BF16)
+  #define FIELD ushort
+  #define LOAD(_array, _i) as_float((uint)((_array)[_i]) << 16)
+  #define STORE(_array, _i, _value) (_array)[_i] = pack_bf16(_value)
+  #define LOAD2(_array, _i) unpack_bf16x2(vload2((_i), (_array)))
+  #define STORE2(_array, _i, _value) vstore2(pack_bf16x2(_value), (_i), (_array))
+
+  // Round to nearest even on the 16 bits dropped from the mantissa
+  static ushort pack_bf16(const float _value)
+  {
+    uint bits = as_uint(_value);
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return (ushort)(bits >> 16);
+  }
+
+  static float2 unpack_bf16x2(const ushort2 _value)
+  {
+    return (float2)(as_float((uint)(_value.x) << 16), as_float((uint)(_value.y) << 16));
+  }
+
+  static ushort2 pack_bf16x2(const float2 _value)
+  {
+    return (ushort2)(pack_bf16(_value.x), pack_bf16(_value.y));
+  }
+#else
+  #define FIELD float
+  #define LOAD(_array, _i) (_array)[_i]
+  #define STORE(_array, _i, _value) (_array)[_i] = (_value)
+  #define LOAD2(_array, _i) vload2((_i), (_array))
+  #define STORE2(_array, _i, _value) vstore2((_value), (_i), (_array))
+#endif
+
+// Layout of the fields, also chosen with a define. Planar fields keep a and b
+// in separate buffers. Interleaved fields keep the a and b of each cell side
+// by side in the a buffers, so each neighbour is one load and the b buffers
+// are not used. Kernels only touch global memory a cell at a time.
+#if defined(LAYOUT_INTERLEAVED)
+  #define LOAD_A(_a, _i) LOAD(_a, 2 * (_i))
+  #define LOAD_CELL(_a, _b, _i) LOAD2(_a, _i)
+  #define STORE_CELL(_a, _b, _i, _value) STORE2(_a, _i, _value)
+#else
+  #define LOAD_A(_a, _i) LOAD(_a, _i)
+  #define LOAD_CELL(_a, _b, _i) (float2)(LOAD(_a, _i), LOAD(_b, _i))
+  #define STORE_CELL(_a, _b, _i, _value) store_planar(_a, _b, _i, _value)
+
+  static void store_planar(__global FIELD* _a, __global FIELD* _b, const size_t _i, const float2 _value)
+  {
+    STORE(_a, _i, _value.x);
+    STORE(_b, _i, _value.y);
+  }
+#endif
+
+// Grid dimensions. A program specialized for one grid is built with them
+// defined, so indexing and wrapping work on constants and the kernel
+// arguments are ignored.
+#if defined(GRID_WIDTH)
+  #define GRID_W(_width) GRID_WIDTH
+  #define GRID_H(_height) GRID_HEIGHT
+  #define GRID_S(_stride) GRID_STRIDE
+  #define GRID_D(_depth) GRID_DEPTH
+#else
+  #define GRID_W(_width) (int)(_width)
+  #define GRID_H(_height) (int)(_height)
+  #define GRID_S(_stride) (_stride)
+  #define GRID_D(_depth) (_depth)
+#endif
+
+// Coefficients, folded in the same way when the program is built for fixed
+// values. Parameter sweeps read theirs per instance and never fix them.
+#if defined(FIXED_INPUT)
+  #define PARAMETER(_input, _name) INPUT_##_name
+#else
+  #define PARAMETER(_input, _name) (_input)._name
+#endif
+
+// Weights of the 9-point stencil
+#ifndef STENCIL_CORNER
+  #define STENCIL_CORNER 0.05f
+  #define STENCIL_EDGE 0.2f
+  #define STENCIL_CENTRE -1.f
+#endif
+
+// Weights of the volume stencils, scaled like the 9-point one so the
+// neighbours sum to 1 against a centre of -1. The 27-point stencil weighs
+// face, edge and corner neighbours 6:3:2.
+#define VOLUME_CENTRE -1.f
+#if defined(VOLUME_STENCIL_27)
+  #define VOLUME_FACE (6.f / 88.f)
+  #define VOLUME_EDGE (3.f / 88.f)
+  #define VOLUME_CORNER (2.f / 88.f)
+#else
+  #define VOLUME_FACE (1.f / 6.f)
+#endif
+
 static int mod(const int _a, const int _b)
 {
   int value = _a % _b;
@@ -15,50 +118,772 @@ static int mod(const int _a, const int _b)
   return value;
 }
 
-static float laplacian(__global float* _array, const int _point, const int _width, const int _height)
+static float2 laplacian_rows(__global const FIELD* _a, __global const FIELD* _b, const int _negative_x, const int _x, const int _positive_x, const size_t _negative_y, const size_t _y, const size_t _positive_y)
 {
-  int xpos = _point % _width;
-  int ypos = _point / _width;
-  int positive_x = mod(xpos + 1, _width);
-  int negative_x = mod(xpos - 1, _width);
-  int positive_y = mod(ypos + 1, _height) * _width;
-  int negative_y = mod(ypos - 1, _height) * _width;
+  return LOAD_CELL(_a, _b, _positive_y + _negative_x) * STENCIL_CORNER + LOAD_CELL(_a, _b, _positive_y + _x) * STENCIL_EDGE + LOAD_CELL(_a, _b, _positive_y + _positive_x) * STENCIL_CORNER
+  + LOAD_CELL(_a, _b, _y + _negative_x) * STENCIL_EDGE + LOAD_CELL(_a, _b, _y + _x) * STENCIL_CENTRE + LOAD_CELL(_a, _b, _y + _positive_x) * STENCIL_EDGE
+  + LOAD_CELL(_a, _b, _negative_y + _negative_x) * STENCIL_CORNER + LOAD_CELL(_a, _b, _negative_y + _x) * STENCIL_EDGE + LOAD_CELL(_a, _b, _negative_y + _positive_x) * STENCIL_CORNER;
+}
 
-  int index[] = {
-    negative_x + positive_y, xpos + positive_y, positive_x + positive_y,
-    negative_x + ypos * _width, xpos + ypos * _width, positive_x + ypos * _width,
-    negative_x + negative_y, xpos + negative_y, positive_x + negative_y
-  };
+// Neighbours wrap by comparison rather than a remainder, only the cell's own
+// position needs a division, which becomes a shift or multiply for a constant stride
+static float2 laplacian(__global const FIELD* _a, __global const FIELD* _b, const int _point, const int _width, const int _height, const int _stride)
+{
+  const int xpos = _point % _stride;
+  const int ypos = _point / _stride;
+  const int negative_x = xpos == 0 ? _width - 1 : xpos - 1;
+  const int positive_x = xpos == _width - 1 ? 0 : xpos + 1;
+  const int negative_y = (ypos == 0 ? _height - 1 : ypos - 1) * _stride;
+  const int positive_y = (ypos == _height - 1 ? 0 : ypos + 1) * _stride;
 
-  float weight[] = {
-    0.05f, 0.2f, 0.05f,
-    0.2f, -1.f, 0.2f,
-    0.05f, 0.2f, 0.05f
-  };
+  return laplacian_rows(_a, _b, negative_x, xpos, positive_x, negative_y, ypos * _stride, positive_y);
+}
+
+// Gray-Scott rate of change of one cell given as (a, b) and its laplacian
+static float2 rate(const float2 _cell, const float2 _laplacian, const struct InputData _input)
+{
+  const float a = _cell.x;
+  const float b = _cell.y;
+  const float reaction = a * (b * b);
 
-  float output = _array[index[0]] * weight[0] + _array[index[1]] * weight[1] + _array[index[2]] * weight[2]
-  + _array[index[3]] * weight[3] + _array[index[4]] * weight[4] + _array[index[5]] * weight[5]
-  + _array[index[6]] * weight[6] + _array[index[7]] * weight[7] + _array[index[8]] * weight[8];
+  const float f = PARAMETER(_input, f);
 
-  return output;
+  return (float2)(
+    PARAMETER(_input, Da) * _laplacian.x - reaction + f * (1.f - a),
+    PARAMETER(_input, Db) * _laplacian.y + reaction - (PARAMETER(_input, k) + f) * b);
 }
 
-__kernel void square(
-  __global float* a_current,
-  __global float* b_current,
-  __global float* a_buffer,
-  __global float* b_buffer,
-  __write_only image2d_t image,
-  struct InputData input,
+// Forward Euler update of one cell
+static float2 react(const float2 _cell, const float2 _laplacian, const struct InputData _input)
+{
+  return _cell + rate(_cell, _laplacian, _input) * PARAMETER(_input, delta);
+}
+
+// Coefficients of one cell of a plane. Programs built with MAP_F or MAP_K take
+// f or k from a map of (f, k) pairs, one per cell, shared by every plane of a
+// volume. Without either the map is never read and may be NULL.
+static struct InputData cell_input(const struct InputData _input, __global const float2* _map, const size_t _i)
+{
+  struct InputData input = _input;
+#if defined(MAP_F)
+  input.f = _map[_i].x;
+#endif
+#if defined(MAP_K)
+  input.k = _map[_i].y;
+#endif
+  return input;
+}
+
+static void update(
+  __global FIELD* a_current,
+  __global FIELD* b_current,
+  __global FIELD* a_buffer,
+  __global FIELD* b_buffer,
+  const size_t i,
+  const struct InputData input,
+  const int width,
+  const int height,
+  const int stride)
+{
+  const float2 cell = react(LOAD_CELL(a_buffer, b_buffer, i), laplacian(a_buffer, b_buffer, i, width, height, stride), input);
+  STORE_CELL(a_current, b_current, i, cell);
+}
+
+// Solver step. The range covers the padded rows, so padding cells at the end
+// of each row are skipped.
+__kernel void simulate(
+  __global FIELD* a_current,
+  __global FIELD* b_current,
+  __global FIELD* a_buffer,
+  __global FIELD* b_buffer,
+  __constant struct InputData* parameters,
   float width,
-  float height)
+  float height,
+  int stride,
+  __global const float2* map)
 {
+  const int w = GRID_W(width);
+  const int h = GRID_H(height);
+  const int pitch = GRID_S(stride);
+
   size_t i = get_global_id(0);
+  if(i % pitch >= w)
+    return;
+
+  update(a_current, b_current, a_buffer, b_buffer, i, cell_input(*parameters, map, i), w, h, pitch);
+}
+
+// Grey scale image of a for display, run only when a frame is presented. The
+// range covers the image, each pixel averaging a factor x factor block of
+// cells so domains larger than the window are downsampled.
+static void colormap_plane(
+  __global const FIELD* a_current,
+  const size_t plane,
+  const int w,
+  const int h,
+  const int pitch,
+  const int factor,
+  __write_only image2d_t image)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  const int x_begin = x * factor;
+  const int y_begin = y * factor;
+  const int x_end = min(x_begin + factor, w);
+  const int y_end = min(y_begin + factor, h);
+  if(x_begin >= x_end || y_begin >= y_end)
+    return;
+
+  float sum = 0.f;
+  for(int j = y_begin; j < y_end; ++j)
+  {
+    for(int i = x_begin; i < x_end; ++i)
+    {
+      sum += LOAD_A(a_current, plane + j * pitch + i);
+    }
+  }
+
+  write_imagef(image, (int2)(x, y), sum / ((x_end - x_begin) * (y_end - y_begin)));
+}
+
+__kernel void colormap(
+  __global const FIELD* a_current,
+  float width,
+  float height,
+  int stride,
+  int factor,
+  __write_only image2d_t image)
+{
+  colormap_plane(a_current, 0, GRID_W(width), GRID_H(height), GRID_S(stride), factor, image);
+}
+
+// Preview of a volume, the same image of a for one of its planes
+__kernel void colormap_slice(
+  __global const FIELD* a_current,
+  float width,
+  float height,
+  int stride,
+  int factor,
+  __write_only image2d_t image,
+  int slice)
+{
+  const size_t plane = (size_t)slice * GRID_S(stride) * GRID_H(height);
+  colormap_plane(a_current, plane, GRID_W(width), GRID_H(height), GRID_S(stride), factor, image);
+}
+
+static float laplacian_local(__local float* _tile, const int _point, const int _stride)
+{
+  return _tile[_point + _stride - 1] * STENCIL_CORNER + _tile[_point + _stride] * STENCIL_EDGE + _tile[_point + _stride + 1] * STENCIL_CORNER
+  + _tile[_point - 1] * STENCIL_EDGE + _tile[_point] * STENCIL_CENTRE + _tile[_point + 1] * STENCIL_EDGE
+  + _tile[_point - _stride - 1] * STENCIL_CORNER + _tile[_point - _stride] * STENCIL_EDGE + _tile[_point - _stride + 1] * STENCIL_CORNER;
+}
+
+// Step the cells of one tile of the grid. The work-group loads the tile of a
+// and b with a one cell halo into local memory, wrapping only on tiles at the borders.
+static void step_tile(
+  __global FIELD* a_current,
+  __global FIELD* b_current,
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  const struct InputData input,
+  const int w,
+  const int h,
+  const int pitch,
+  const int tile_column,
+  const int tile_row,
+  __global const float2* map,
+  __local float* a_tile,
+  __local float* b_tile)
+{
+  const int local_x = get_local_id(0);
+  const int local_y = get_local_id(1);
+  const int group_x = get_local_size(0);
+  const int group_y = get_local_size(1);
+  const int tile_x = group_x + 2;
+  const int tile_y = group_y + 2;
+  const int origin_x = tile_column * group_x - 1;
+  const int origin_y = tile_row * group_y - 1;
+  const bool border = origin_x < 0 || origin_y < 0 || origin_x + tile_x > w || origin_y + tile_y > h;
+
+  for(int ty = local_y; ty < tile_y; ty += group_y)
+  {
+    int gy = origin_y + ty;
+    if(border)
+      gy = mod(gy, h);
+
+    for(int tx = local_x; tx < tile_x; tx += group_x)
+    {
+      int gx = origin_x + tx;
+      if(border)
+        gx = mod(gx, w);
+
+      const float2 cell = LOAD_CELL(a_buffer, b_buffer, gy * pitch + gx);
+      a_tile[ty * tile_x + tx] = cell.x;
+      b_tile[ty * tile_x + tx] = cell.y;
+    }
+  }
+
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Tiles on the right and bottom borders may be partial
+  const int x = origin_x + 1 + local_x;
+  const int y = origin_y + 1 + local_y;
+  if(x >= w || y >= h)
+    return;
+
+  const int t = (local_y + 1) * tile_x + local_x + 1;
+  const float2 lap = (float2)(laplacian_local(a_tile, t, tile_x), laplacian_local(b_tile, t, tile_x));
+  STORE_CELL(a_current, b_current, y * pitch + x, react((float2)(a_tile[t], b_tile[t]), lap, cell_input(input, map, y * pitch + x)));
+}
+
+// Solver step over a 2D range rounded up to whole work-groups, one tile each
+__kernel void simulate_tiled(
+  __global FIELD* a_current,
+  __global FIELD* b_current,
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  __constant struct InputData* parameters,
+  float width,
+  float height,
+  int stride,
+  __local float* a_tile,
+  __local float* b_tile,
+  __global const float2* map)
+{
+  step_tile(a_current, b_current, a_buffer, b_buffer, *parameters, GRID_W(width), GRID_H(height), GRID_S(stride),
+    get_group_id(0), get_group_id(1), map, a_tile, b_tile);
+}
+
+// Solver step over the tiles of a compacted work list, one work-group per
+// listed tile laid out along the first dimension. Tiles missing from the list
+// are not written, their cells must hold the same state in both buffers.
+__kernel void simulate_active(
+  __global FIELD* a_current,
+  __global FIELD* b_current,
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  __constant struct InputData* parameters,
+  float width,
+  float height,
+  int stride,
+  __global const uint* tiles,
+  int tile_columns,
+  __local float* a_tile,
+  __local float* b_tile,
+  __global const float2* map)
+{
+  const uint tile = tiles[get_group_id(0)];
+  step_tile(a_current, b_current, a_buffer, b_buffer, *parameters, GRID_W(width), GRID_H(height), GRID_S(stride),
+    tile % tile_columns, tile / tile_columns, map, a_tile, b_tile);
+}
+
+// Load plane z of a and b into a tile with a one cell halo, wrapping on the borders
+static void load_plane(
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  const int z,
+  const int w,
+  const int h,
+  const int pitch,
+  const int origin_x,
+  const int origin_y,
+  const bool border,
+  __local float* a_tile,
+  __local float* b_tile)
+{
+  const int local_x = get_local_id(0);
+  const int local_y = get_local_id(1);
+  const int group_x = get_local_size(0);
+  const int group_y = get_local_size(1);
+  const int tile_x = group_x + 2;
+  const int tile_y = group_y + 2;
+  const size_t plane = (size_t)z * pitch * h;
+
+  for(int ty = local_y; ty < tile_y; ty += group_y)
+  {
+    int gy = origin_y + ty;
+    if(border)
+      gy = mod(gy, h);
+
+    for(int tx = local_x; tx < tile_x; tx += group_x)
+    {
+      int gx = origin_x + tx;
+      if(border)
+        gx = mod(gx, w);
+
+      const float2 cell = LOAD_CELL(a_buffer, b_buffer, plane + gy * pitch + gx);
+      a_tile[ty * tile_x + tx] = cell.x;
+      b_tile[ty * tile_x + tx] = cell.y;
+    }
+  }
+}
+
+// Weighted 3x3 neighbourhood of one plane, in the order of laplacian_local
+static float stencil_plane(__local const float* _tile, const int _point, const int _stride, const float _centre, const float _edge, const float _corner)
+{
+  return _tile[_point + _stride - 1] * _corner + _tile[_point + _stride] * _edge + _tile[_point + _stride + 1] * _corner
+  + _tile[_point - 1] * _edge + _tile[_point] * _centre + _tile[_point + 1] * _edge
+  + _tile[_point - _stride - 1] * _corner + _tile[_point - _stride] * _edge + _tile[_point - _stride + 1] * _corner;
+}
+
+// Volume laplacian from the planes above, at and below the cell
+static float laplacian_volume(__local const float* _above, __local const float* _centre, __local const float* _below, const int _point, const int _stride)
+{
+#if defined(VOLUME_STENCIL_27)
+  return stencil_plane(_above, _point, _stride, VOLUME_FACE, VOLUME_EDGE, VOLUME_CORNER)
+  + stencil_plane(_centre, _point, _stride, VOLUME_CENTRE, VOLUME_FACE, VOLUME_EDGE)
+  + stencil_plane(_below, _point, _stride, VOLUME_FACE, VOLUME_EDGE, VOLUME_CORNER);
+#else
+  return _above[_point] * VOLUME_FACE
+  + _centre[_point + _stride] * VOLUME_FACE
+  + _centre[_point - 1] * VOLUME_FACE + _centre[_point] * VOLUME_CENTRE + _centre[_point + 1] * VOLUME_FACE
+  + _centre[_point - _stride] * VOLUME_FACE
+  + _below[_point] * VOLUME_FACE;
+#endif
+}
+
+// Solver step of a volume of depth planes over a 3D range of whole
+// work-groups, each one x/y tile of a slab of planes along z. The work-group
+// marches up its slab keeping three planes of the tile with their halo in
+// local memory, loading only the next one per step. Planes wrap like rows.
+__kernel void simulate_volume(
+  __global FIELD* a_current,
+  __global FIELD* b_current,
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  __constant struct InputData* parameters,
+  float width,
+  float height,
+  int stride,
+  int depth,
+  int slab,
+  __local float* a_planes,
+  __local float* b_planes,
+  __global const float2* map)
+{
+  const struct InputData input = *parameters;
+  const int w = GRID_W(width);
+  const int h = GRID_H(height);
+  const int pitch = GRID_S(stride);
+  const int d = GRID_D(depth);
+
+  const int local_x = get_local_id(0);
+  const int local_y = get_local_id(1);
+  const int group_x = get_local_size(0);
+  const int group_y = get_local_size(1);
+  const int tile_x = group_x + 2;
+  const int area = tile_x * (group_y + 2);
+  const int origin_x = get_group_id(0) * group_x - 1;
+  const int origin_y = get_group_id(1) * group_y - 1;
+  const bool border = origin_x < 0 || origin_y < 0 || origin_x + tile_x > w || origin_y + group_y + 2 > h;
+
+  const int z_begin = get_group_id(2) * slab;
+  const int z_end = min(z_begin + slab, d);
+
+  // Every work-item of a partial tile still loads and reaches the barriers
+  const int x = origin_x + 1 + local_x;
+  const int y = origin_y + 1 + local_y;
+  const bool inside = x < w && y < h;
+  const int t = (local_y + 1) * tile_x + local_x + 1;
+
+  load_plane(a_buffer, b_buffer, mod(z_begin - 1, d), w, h, pitch, origin_x, origin_y, border, a_planes, b_planes);
+  load_plane(a_buffer, b_buffer, z_begin, w, h, pitch, origin_x, origin_y, border, a_planes + area, b_planes + area);
+
+  for(int z = z_begin; z < z_end; ++z)
+  {
+    const int below = (z - z_begin) % 3 * area;
+    const int centre = (z - z_begin + 1) % 3 * area;
+    const int above = (z - z_begin + 2) % 3 * area;
+    load_plane(a_buffer, b_buffer, z + 1 == d ? 0 : z + 1, w, h, pitch, origin_x, origin_y, border, a_planes + above, b_planes + above);
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if(inside)
+    {
+      const float2 lap = (float2)(
+        laplacian_volume(a_planes + above, a_planes + centre, a_planes + below, t, tile_x),
+        laplacian_volume(b_planes + above, b_planes + centre, b_planes + below, t, tile_x));
+      const float2 cell = (float2)(a_planes[centre + t], b_planes[centre + t]);
+      STORE_CELL(a_current, b_current, (size_t)z * pitch * h + y * pitch + x, react(cell, lap, cell_input(input, map, y * pitch + x)));
+    }
+
+    // The plane below is overwritten by the next load
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+}
+
+// Temporally blocked solver step advancing several iterations per launch. Each
+// work-group loads its tile with a halo as wide as the number of steps, then
+// iterates in local memory on a region that shrinks by one cell per step, so
+// global memory is only touched once on the way in and once on the way out.
+__kernel void simulate_blocked(
+  __global FIELD* a_current,
+  __global FIELD* b_current,
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  __constant struct InputData* parameters,
+  float width,
+  float height,
+  int stride,
+  int steps,
+  __local float* a_tile,
+  __local float* b_tile,
+  __local float* a_next,
+  __local float* b_next,
+  __global const float2* map)
+{
+  const struct InputData input = *parameters;
+  const int w = GRID_W(width);
+  const int h = GRID_H(height);
+  const int pitch = GRID_S(stride);
+  const int local_x = get_local_id(0);
+  const int local_y = get_local_id(1);
+  const int group_x = get_local_size(0);
+  const int group_y = get_local_size(1);
+  const int tile_x = group_x + 2 * steps;
+  const int tile_y = group_y + 2 * steps;
+  const int origin_x = get_group_id(0) * group_x - steps;
+  const int origin_y = get_group_id(1) * group_y - steps;
+  const bool border = origin_x < 0 || origin_y < 0 || origin_x + tile_x > w || origin_y + tile_y > h;
+
+  for(int ty = local_y; ty < tile_y; ty += group_y)
+  {
+    int gy = origin_y + ty;
+    if(border)
+      gy = mod(gy, h);
+
+    for(int tx = local_x; tx < tile_x; tx += group_x)
+    {
+      int gx = origin_x + tx;
+      if(border)
+        gx = mod(gx, w);
+
+      const float2 cell = LOAD_CELL(a_buffer, b_buffer, gy * pitch + gx);
+      a_tile[ty * tile_x + tx] = cell.x;
+      b_tile[ty * tile_x + tx] = cell.y;
+    }
+  }
+
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  __local float* a_in = a_tile;
+  __local float* b_in = b_tile;
+  __local float* a_out = a_next;
+  __local float* b_out = b_next;
+
+  for(int s = 1; s <= steps; ++s)
+  {
+    for(int ty = s + local_y; ty < tile_y - s; ty += group_y)
+    {
+      for(int tx = s + local_x; tx < tile_x - s; tx += group_x)
+      {
+        const int t = ty * tile_x + tx;
+        const float2 lap = (float2)(laplacian_local(a_in, t, tile_x), laplacian_local(b_in, t, tile_x));
+        const float2 cell = react((float2)(a_in[t], b_in[t]), lap, cell_input(input, map, mod(origin_y + ty, h) * pitch + mod(origin_x + tx, w)));
+        a_out[t] = cell.x;
+        b_out[t] = cell.y;
+      }
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    __local float* a_swap = a_in;
+    __local float* b_swap = b_in;
+    a_in = a_out;
+    b_in = b_out;
+    a_out = a_swap;
+    b_out = b_swap;
+  }
+
+  // The range is rounded up to whole work-groups
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= w || y >= h)
+    return;
+
+  const int t = (local_y + steps) * tile_x + local_x + steps;
+  STORE_CELL(a_current, b_current, y * pitch + x, (float2)(a_in[t], b_in[t]));
+}
+
+// Batched solver step for parameter sweeps. Independent domains are stacked
+// one after another in the same buffers and the third dimension of the range
+// selects the domain, each with its own coefficients from the inputs array.
+__kernel void simulate_batch(
+  __global FIELD* a_current,
+  __global FIELD* b_current,
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  __global const struct InputData* inputs,
+  int width,
+  int height,
+  int stride)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  const int instance = get_global_id(2);
+  const struct InputData input = inputs[instance];
+
+  const size_t offset = (size_t)(instance) * stride * height;
+
+  const int negative_x = x == 0 ? width - 1 : x - 1;
+  const int positive_x = x == width - 1 ? 0 : x + 1;
+  const size_t negative_y = offset + (y == 0 ? height - 1 : y - 1) * stride;
+  const size_t positive_y = offset + (y == height - 1 ? 0 : y + 1) * stride;
+  const size_t row = offset + y * stride;
+
+  const float2 lap = laplacian_rows(a_buffer, b_buffer, negative_x, x, positive_x, negative_y, row, positive_y);
+  STORE_CELL(a_current, b_current, row + x, react(LOAD_CELL(a_buffer, b_buffer, row + x), lap, input));
+}
+
+// Solver step over rows starting at row_begin of one strip of a domain split
+// across devices. Strips hold halo rows above and below that are refreshed
+// from their neighbours, so only x wraps around here.
+__kernel void simulate_strip(
+  __global FIELD* a_current,
+  __global FIELD* b_current,
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  struct InputData input,
+  int width,
+  int row_begin,
+  int stride)
+{
+  const int x = get_global_id(0);
+  const size_t row = (size_t)(row_begin + get_global_id(1)) * stride;
+
+  const int negative_x = x == 0 ? width - 1 : x - 1;
+  const int positive_x = x == width - 1 ? 0 : x + 1;
+
+  const float2 lap = laplacian_rows(a_buffer, b_buffer, negative_x, x, positive_x, row - stride, row, row + stride);
+  STORE_CELL(a_current, b_current, row + x, react(LOAD_CELL(a_buffer, b_buffer, row + x), lap, input));
+}
+
+static float2 laplacian_stage(__global const float2* _stage, const int _negative_x, const int _x, const int _positive_x, const size_t _negative_y, const size_t _y, const size_t _positive_y)
+{
+  return _stage[_positive_y + _negative_x] * STENCIL_CORNER + _stage[_positive_y + _x] * STENCIL_EDGE + _stage[_positive_y + _positive_x] * STENCIL_CORNER
+  + _stage[_y + _negative_x] * STENCIL_EDGE + _stage[_y + _x] * STENCIL_CENTRE + _stage[_y + _positive_x] * STENCIL_EDGE
+  + _stage[_negative_y + _negative_x] * STENCIL_CORNER + _stage[_negative_y + _x] * STENCIL_EDGE + _stage[_negative_y + _positive_x] * STENCIL_CORNER;
+}
+
+// One stage of a Runge-Kutta step over a 2D range. The first stage is
+// evaluated at the fields and the others at the state written by the stage
+// before, kept in fp32 whatever the storage. Each stage adds its weighted rate
+// to the sum and writes the state the next stage is evaluated at, scale
+// deltas ahead of the fields. The last stage writes the new fields instead.
+__kernel void simulate_stage(
+  __global FIELD* a_current,
+  __global FIELD* b_current,
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  __constant struct InputData* parameters,
+  int width,
+  int height,
+  int stride,
+  __global const float2* stage_in,
+  __global float2* stage_out,
+  __global float2* sum,
+  int first,
+  int last,
+  float weight,
+  float scale,
+  __global const float2* map)
+{
+  const int w = GRID_W(width);
+  const int h = GRID_H(height);
+  const int pitch = GRID_S(stride);
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  const int negative_x = x == 0 ? w - 1 : x - 1;
+  const int positive_x = x == w - 1 ? 0 : x + 1;
+  const size_t negative_y = (y == 0 ? h - 1 : y - 1) * pitch;
+  const size_t positive_y = (y == h - 1 ? 0 : y + 1) * pitch;
+  const size_t row = y * pitch;
+  const struct InputData input = cell_input(*parameters, map, row + x);
+
+  const float2 cell = LOAD_CELL(a_buffer, b_buffer, row + x);
+  float2 change;
+  if(first)
+    change = rate(cell, laplacian_rows(a_buffer, b_buffer, negative_x, x, positive_x, negative_y, row, positive_y), input);
+  else
+    change = rate(stage_in[row + x], laplacian_stage(stage_in, negative_x, x, positive_x, negative_y, row, positive_y), input);
+
+  const float delta = PARAMETER(input, delta);
+  const float2 total = (first ? (float2)(0.f, 0.f) : sum[row + x]) + change * weight;
+  if(last)
+  {
+    STORE_CELL(a_current, b_current, row + x, cell + total * delta);
+    return;
+  }
+
+  sum[row + x] = total;
+  stage_out[row + x] = cell + change * (scale * delta);
+}
+
+// Change of a cell between the two field buffers, the larger of a and b.
+// Cells that are not a number count as an infinite change.
+static float cell_change(
+  __global const FIELD* a_current,
+  __global const FIELD* b_current,
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  const size_t _i)
+{
+  const float2 difference = fabs(LOAD_CELL(a_current, b_current, _i) - LOAD_CELL(a_buffer, b_buffer, _i));
+  return isnan(difference.x) || isnan(difference.y) ? INFINITY : max(difference.x, difference.y);
+}
+
+// Largest value over a work-group, halving the active values each pass so
+// work-groups need not be a power of two
+static float group_max(__local float* scratch, const float _value)
+{
+  const int index = get_local_id(1) * get_local_size(0) + get_local_id(0);
+  int active = get_local_size(0) * get_local_size(1);
+
+  scratch[index] = _value;
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  while(active > 1)
+  {
+    const int half = (active + 1) / 2;
+    if(index < active - half)
+      scratch[index] = max(scratch[index], scratch[index + half]);
+    barrier(CLK_LOCAL_MEM_FENCE);
+    active = half;
+  }
+
+  return scratch[0];
+}
+
+// Largest change of a or b between the two field buffers, reduced within each
+// work-group in local memory and across work-groups with an atomic max on the
+// bits of the result. Non-negative floats order like their bits as unsigned integers.
+__kernel void change_max(
+  __global const FIELD* a_current,
+  __global const FIELD* b_current,
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  int width,
+  int height,
+  int stride,
+  __global uint* result,
+  __local float* scratch)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  // The range is rounded up to whole work-groups
+  float change = 0.f;
+  if(x < GRID_W(width) && y < GRID_H(height))
+    change = cell_change(a_current, b_current, a_buffer, b_buffer, y * GRID_S(stride) + x);
+
+  change = group_max(scratch, change);
+  if(get_local_id(0) == 0 && get_local_id(1) == 0)
+    atomic_max(result, as_uint(change));
+}
+
+// Mark the tiles whose largest change between the two field buffers is above
+// the threshold, one work-group per tile over the range of the tiled kernel
+__kernel void tile_activity(
+  __global const FIELD* a_current,
+  __global const FIELD* b_current,
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  int width,
+  int height,
+  int stride,
+  float threshold,
+  __global uchar* mask,
+  __local float* scratch)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
 
-  float reaction = a_buffer[i] * (b_buffer[i] * b_buffer[i]);
+  float change = 0.f;
+  if(x < GRID_W(width) && y < GRID_H(height))
+    change = cell_change(a_current, b_current, a_buffer, b_buffer, y * GRID_S(stride) + x);
 
-  a_current[i] = a_buffer[i] + (input.Da * laplacian(a_buffer, i, width, height) - reaction + input.f * (1.f - a_buffer[i])) * input.delta;
-  b_current[i] = b_buffer[i] + (input.Db * laplacian(b_buffer, i, width, height) + reaction - (input.k + input.f) * b_buffer[i]) * input.delta;
+  change = group_max(scratch, change);
+  if(get_local_id(0) == 0 && get_local_id(1) == 0)
+    mask[get_group_id(1) * get_num_groups(0) + get_group_id(0)] = change > threshold;
+}
 
-  write_imagef(image, (int2)(i % (int)(width), i / (int)(width)), a_current[i]);
-}
\ No newline at end of file
+// First tile and number of tiles along one axis covering the cells from _begin
+// to _end, which may wrap around the grid
+static int2 tile_span(const int _begin, const int _end, const int _extent, const int _tile, const int _tiles)
+{
+  // Spans that could wrap back into their first tile cover every tile
+  if(_end - _begin + _tile > _extent)
+    return (int2)(0, _tiles);
+
+  const int first = mod(_begin, _extent) / _tile;
+  const int last = mod(_end - 1, _extent) / _tile;
+  return (int2)(first, (last - first + _tiles) % _tiles + 1);
+}
+
+// Compact the tiles within reach cells of an active tile into a work list,
+// one work-item per tile, flagging each tile as listed or not. The order of
+// the list depends on the order the work-items run in, but every tile writes
+// only its own cells.
+__kernel void compact_tiles(
+  __global const uchar* mask,
+  int width,
+  int height,
+  int tile_width,
+  int tile_height,
+  int reach,
+  __global uint* tiles,
+  __global uint* count,
+  __global uchar* listed)
+{
+  const int w = GRID_W(width);
+  const int h = GRID_H(height);
+  const int columns = (w + tile_width - 1) / tile_width;
+  const int rows = (h + tile_height - 1) / tile_height;
+  const int tile = get_global_id(0);
+  if(tile >= columns * rows)
+    return;
+
+  const int column = tile % columns;
+  const int row = tile / columns;
+  const int2 span_x = tile_span(column * tile_width - reach, min((column + 1) * tile_width, w) + reach, w, tile_width, columns);
+  const int2 span_y = tile_span(row * tile_height - reach, min((row + 1) * tile_height, h) + reach, h, tile_height, rows);
+
+  for(int j = 0; j < span_y.y; ++j)
+  {
+    const int neighbour_row = (span_y.x + j) % rows;
+    for(int i = 0; i < span_x.y; ++i)
+    {
+      if(mask[neighbour_row * columns + (span_x.x + i) % columns])
+      {
+        tiles[atomic_inc(count)] = tile;
+        listed[tile] = 1;
+        return;
+      }
+    }
+  }
+  listed[tile] = 0;
+}
+
+// Copy the tiles left out of the work list from the latest fields into the
+// buffers the next step writes, one work-group per tile. Tiles that settled
+// with changes below a non-zero threshold then hold the same state in both
+// buffers and stay put while the buffers swap.
+__kernel void copy_settled(
+  __global FIELD* a_current,
+  __global FIELD* b_current,
+  __global const FIELD* a_buffer,
+  __global const FIELD* b_buffer,
+  int width,
+  int height,
+  int stride,
+  __global const uchar* listed)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= GRID_W(width) || y >= GRID_H(height) || listed[get_group_id(1) * get_num_groups(0) + get_group_id(0)])
+    return;
+
+  const size_t i = y * GRID_S(stride) + x;
+  STORE_CELL(a_current, b_current, i, LOAD_CELL(a_buffer, b_buffer, i));
+}
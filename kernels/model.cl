@@ -0,0 +1,71 @@
+// Kernels of generated reaction-diffusion models. The program is built from
+// the source a model generates, defining MODEL_SPECIES and model_update,
+// followed by image.cl for the grid, stencil and wrapping helpers, and this file.
+
+// Model step over a 2D range rounded up to whole work-groups, one tile each.
+// The species are planes of one buffer, plane floats apart. The work-group
+// loads the tile of every species with a one cell halo into local memory,
+// wrapping only on tiles at the borders.
+__kernel void model_tiled(
+  __global float* current,
+  __global const float* buffer,
+  float width,
+  float height,
+  int stride,
+  int plane,
+  __local float* tile)
+{
+  const int w = GRID_W(width);
+  const int h = GRID_H(height);
+  const int pitch = GRID_S(stride);
+
+  const int local_x = get_local_id(0);
+  const int local_y = get_local_id(1);
+  const int group_x = get_local_size(0);
+  const int group_y = get_local_size(1);
+  const int tile_x = group_x + 2;
+  const int tile_y = group_y + 2;
+  const int area = tile_x * tile_y;
+  const int origin_x = get_group_id(0) * group_x - 1;
+  const int origin_y = get_group_id(1) * group_y - 1;
+  const bool border = origin_x < 0 || origin_y < 0 || origin_x + tile_x > w || origin_y + tile_y > h;
+
+  for(int ty = local_y; ty < tile_y; ty += group_y)
+  {
+    int gy = origin_y + ty;
+    if(border)
+      gy = mod(gy, h);
+
+    for(int tx = local_x; tx < tile_x; tx += group_x)
+    {
+      int gx = origin_x + tx;
+      if(border)
+        gx = mod(gx, w);
+
+      for(int s = 0; s < MODEL_SPECIES; ++s)
+        tile[s * area + ty * tile_x + tx] = buffer[s * plane + gy * pitch + gx];
+    }
+  }
+
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Tiles on the right and bottom borders may be partial
+  const int x = origin_x + 1 + local_x;
+  const int y = origin_y + 1 + local_y;
+  if(x >= w || y >= h)
+    return;
+
+  const int t = (local_y + 1) * tile_x + local_x + 1;
+  float c[MODEL_SPECIES];
+  float l[MODEL_SPECIES];
+  for(int s = 0; s < MODEL_SPECIES; ++s)
+  {
+    c[s] = tile[s * area + t];
+    l[s] = laplacian_local(tile + s * area, t, tile_x);
+  }
+
+  model_update(c, l);
+
+  for(int s = 0; s < MODEL_SPECIES; ++s)
+    current[s * plane + y * pitch + x] = c[s];
+}
@@ -0,0 +1,175 @@
+#include <Checkpoint.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+  #define NOMINMAX
+  #include <windows.h>
+#endif
+
+CheckpointHeader checkpoint_header(const Grid &_grid, const InputData &_input, const unsigned int _iteration, const unsigned int _seed)
+{
+  CheckpointHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.compression = CHECKPOINT_RAW;
+  header.width = _grid.width;
+  header.height = _grid.height;
+  header.stride = _grid.stride;
+  header.depth = _grid.depth;
+  header.seed = _seed;
+  header.iteration = _iteration;
+  header.plane_bytes = sizeof(float) * _grid.size();
+  header.input = _input;
+  return header;
+}
+
+bool write_checkpoint(const std::string &_filepath, const CheckpointHeader &_header, const float *_a, const float *_b)
+{
+  const std::string temporary = _filepath + ".tmp";
+  std::ofstream file(temporary.c_str(), std::ios::out | std::ios::binary);
+  if(!file.is_open())
+  {
+    std::cout << "Checkpoint could not be written: " << temporary << std::endl;
+    return false;
+  }
+
+  char header[CHECKPOINT_DATA_OFFSET];
+  memset(header, 0, sizeof(header));
+  memcpy(header, &_header, sizeof(_header));
+
+  file.write(header, sizeof(header));
+  file.write(reinterpret_cast<const char*>(_a), _header.plane_bytes);
+  file.write(reinterpret_cast<const char*>(_b), _header.plane_bytes);
+  file.close();
+
+  if(!file)
+  {
+    std::cout << "Checkpoint could not be written: " << temporary << std::endl;
+    return false;
+  }
+
+  return commit_checkpoint(_filepath);
+}
+
+bool begin_checkpoint(const std::string &_filepath, const CheckpointHeader &_header)
+{
+  const std::string temporary = _filepath + ".tmp";
+  std::ofstream file(temporary.c_str(), std::ios::out | std::ios::binary);
+
+  char header[CHECKPOINT_DATA_OFFSET];
+  memset(header, 0, sizeof(header));
+  memcpy(header, &_header, sizeof(_header));
+  file.write(header, sizeof(header));
+  file.close();
+
+  if(!file)
+  {
+    std::cout << "Checkpoint could not be written: " << temporary << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool write_checkpoint_rows(const std::string &_filepath, const CheckpointHeader &_header, const int _row, const int _rows, const float *_a, const float *_b)
+{
+  const std::string temporary = _filepath + ".tmp";
+  std::fstream file(temporary.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+
+  const std::size_t offset = sizeof(float) * static_cast<std::size_t>(_header.stride) * _row;
+  const std::size_t bytes = sizeof(float) * static_cast<std::size_t>(_header.stride) * _rows;
+  file.seekp(CHECKPOINT_DATA_OFFSET + offset);
+  file.write(reinterpret_cast<const char*>(_a), bytes);
+  file.seekp(CHECKPOINT_DATA_OFFSET + _header.plane_bytes + offset);
+  file.write(reinterpret_cast<const char*>(_b), bytes);
+  file.close();
+
+  if(!file)
+  {
+    std::cout << "Checkpoint rows could not be written: " << temporary << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool commit_checkpoint(const std::string &_filepath)
+{
+  // Replace the previous checkpoint only once the new one is complete,
+  // with a single atomic rename, so a valid checkpoint exists at all times
+  const std::string temporary = _filepath + ".tmp";
+  #ifdef _WIN32
+    const bool renamed = MoveFileExA(temporary.c_str(), _filepath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+  #else
+    const bool renamed = std::rename(temporary.c_str(), _filepath.c_str()) == 0;
+  #endif
+  if(!renamed)
+  {
+    std::cout << "Checkpoint could not be renamed to " << _filepath << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+Checkpoint::Checkpoint(const std::string &_filepath)
+{
+  try
+  {
+    m_file = boost::interprocess::file_mapping(_filepath.c_str(), boost::interprocess::read_only);
+    m_region = boost::interprocess::mapped_region(m_file, boost::interprocess::read_only);
+  }
+  catch(const boost::interprocess::interprocess_exception &_exception)
+  {
+    std::cout << "Checkpoint could not be opened: " << _filepath << " (" << _exception.what() << ")" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  m_header = static_cast<const CheckpointHeader*>(m_region.get_address());
+
+  if(m_region.get_size() < CHECKPOINT_DATA_OFFSET || memcmp(m_header->magic, CHECKPOINT_MAGIC, sizeof(m_header->magic)) != 0)
+  {
+    std::cout << "Not a checkpoint file: " << _filepath << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if(m_header->version != CHECKPOINT_VERSION || m_header->compression != CHECKPOINT_RAW)
+  {
+    std::cout << "Unsupported checkpoint version " << m_header->version << " with compression " << m_header->compression << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // The stored padding must match this build so the planes can be used as they are
+  const Grid stored = grid();
+  if(stored.stride != m_header->stride || m_header->plane_bytes != sizeof(float) * stored.size() || m_region.get_size() < CHECKPOINT_DATA_OFFSET + 2 * m_header->plane_bytes)
+  {
+    std::cout << "Checkpoint layout does not match: " << _filepath << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+const CheckpointHeader& Checkpoint::header() const
+{
+  return *m_header;
+}
+
+Grid Checkpoint::grid() const
+{
+  return Grid(m_header->width, m_header->height, std::max<boost::uint32_t>(1, m_header->depth));
+}
+
+const float* Checkpoint::a() const
+{
+  return reinterpret_cast<const float*>(static_cast<const char*>(m_region.get_address()) + CHECKPOINT_DATA_OFFSET);
+}
+
+const float* Checkpoint::b() const
+{
+  return a() + m_header->plane_bytes / sizeof(float);
+}
@@ -0,0 +1,341 @@
+#include <ClEnvironment.h>
+#include <Utility.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+  #include <direct.h>
+#else
+  #include <sys/stat.h>
+#endif
+
+// 64-bit FNV-1a hash naming the cache files, the full key is checked on load
+static std::string hash_name(const std::string &_key)
+{
+  unsigned long long hash = 14695981039346656037ULL;
+  for(std::size_t i = 0; i < _key.size(); ++i)
+  {
+    hash ^= static_cast<unsigned char>(_key[i]);
+    hash *= 1099511628211ULL;
+  }
+
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.bin", hash);
+  return name;
+}
+
+static std::string device_string(const cl_device_id _device, const cl_device_info _info)
+{
+  char value[256] = {0};
+  clGetDeviceInfo(_device, _info, sizeof(value) - 1, value, NULL);
+  return value;
+}
+
+ClEnvironment::ClEnvironment(Framebuffer *_framebuffer, const std::string &_cache, const unsigned int _partition)
+  : m_cache(_cache)
+  , m_partition(_partition)
+  , m_device_count(0)
+  , m_device_ids(NULL)
+{
+  createContext(_framebuffer);
+}
+
+ClEnvironment::~ClEnvironment()
+{
+  clReleaseContext(m_context);
+  if(m_partition > 0)
+  {
+    for(cl_uint i = 0; i < m_device_count; ++i)
+      clReleaseDevice(m_device_ids[i]);
+  }
+  delete[] m_device_ids;
+}
+
+cl_program ClEnvironment::build(const char _filepath[], const std::string &_options) const
+{
+  return buildSource(read_file(_filepath), _options);
+}
+
+cl_program ClEnvironment::buildSource(const std::string &_source, const std::string &_options) const
+{
+  // Error code
+  cl_int error = CL_SUCCESS;
+  const char* source[] = {_source.c_str()};
+
+  // Reuse the binaries of an identical earlier build
+  std::string key, cached;
+  if(!m_cache.empty())
+  {
+    key = cacheKey(_source, _options);
+    cached = m_cache + "/" + hash_name(key);
+    cl_program program = loadCached(cached, key, _options);
+    if(program != NULL)
+      return program;
+  }
+
+  // Build program
+  cl_program program = clCreateProgramWithSource(m_context, 1, source, NULL, &error);
+  opencl_error_check(error);
+  error = clBuildProgram(program, m_device_count, m_device_ids, _options.c_str(), NULL, NULL);
+  if(error != CL_SUCCESS)
+  {
+    char buffer[1024];
+    clGetProgramBuildInfo(program, m_device_ids[0], CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, NULL);
+    std::cout << buffer << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if(!m_cache.empty())
+    storeCached(cached, key, program);
+
+  return program;
+}
+
+cl_command_queue ClEnvironment::createQueue(const cl_command_queue_properties _properties, const cl_uint _device) const
+{
+  cl_int error = CL_SUCCESS;
+  cl_command_queue queue = clCreateCommandQueue(m_context, m_device_ids[_device], _properties, &error);
+  opencl_error_check(error);
+  return queue;
+}
+
+cl_context ClEnvironment::context() const
+{
+  return m_context;
+}
+
+cl_device_id ClEnvironment::device(const cl_uint _index) const
+{
+  return m_device_ids[_index];
+}
+
+cl_uint ClEnvironment::deviceCount() const
+{
+  return m_device_count;
+}
+
+std::string ClEnvironment::cacheKey(const std::string &_source, const std::string &_options) const
+{
+  char platform[256] = {0};
+  clGetPlatformInfo(m_platform_id, CL_PLATFORM_NAME, sizeof(platform) - 1, platform, NULL);
+
+  std::string key = std::string(platform) + '\n' + _options + '\n';
+  for(cl_uint i = 0; i < m_device_count; ++i)
+    key += device_string(m_device_ids[i], CL_DEVICE_NAME) + '\n' + device_string(m_device_ids[i], CL_DEVICE_VERSION) + '\n' + device_string(m_device_ids[i], CL_DRIVER_VERSION) + '\n';
+
+  return key + _source;
+}
+
+// Cache files hold the magic, the key and one binary per device, each prefixed by its size
+cl_program ClEnvironment::loadCached(const std::string &_filepath, const std::string &_key, const std::string &_options) const
+{
+  std::ifstream file(_filepath.c_str(), std::ios::binary);
+  if(!file.is_open())
+    return NULL;
+
+  char magic[8];
+  unsigned long long key_size = 0;
+  cl_uint count = 0;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char*>(&key_size), sizeof(key_size));
+  if(!file || std::string(magic, sizeof(magic)) != PROGRAM_CACHE_MAGIC || key_size != _key.size())
+    return NULL;
+
+  std::string key(_key.size(), '\0');
+  file.read(&key[0], key.size());
+  file.read(reinterpret_cast<char*>(&count), sizeof(count));
+  if(!file || key != _key || count != m_device_count)
+    return NULL;
+
+  std::vector<std::vector<unsigned char> > binaries(count);
+  std::vector<std::size_t> sizes(count);
+  std::vector<const unsigned char*> pointers(count);
+  for(cl_uint i = 0; i < count; ++i)
+  {
+    unsigned long long size = 0;
+    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if(!file || size == 0)
+      return NULL;
+
+    binaries[i].resize(size);
+    file.read(reinterpret_cast<char*>(&binaries[i][0]), size);
+    sizes[i] = size;
+    pointers[i] = &binaries[i][0];
+  }
+  if(!file)
+    return NULL;
+
+  // Anything the driver refuses falls back to building from source
+  cl_int error = CL_SUCCESS;
+  std::vector<cl_int> status(count, CL_SUCCESS);
+  cl_program program = clCreateProgramWithBinary(m_context, count, m_device_ids, &sizes[0], &pointers[0], &status[0], &error);
+  if(error != CL_SUCCESS)
+    return NULL;
+
+  error = clBuildProgram(program, m_device_count, m_device_ids, _options.c_str(), NULL, NULL);
+  if(error != CL_SUCCESS)
+  {
+    clReleaseProgram(program);
+    return NULL;
+  }
+
+  return program;
+}
+
+void ClEnvironment::storeCached(const std::string &_filepath, const std::string &_key, cl_program _program) const
+{
+  std::vector<std::size_t> sizes(m_device_count);
+  if(clGetProgramInfo(_program, CL_PROGRAM_BINARY_SIZES, sizeof(std::size_t) * sizes.size(), &sizes[0], NULL) != CL_SUCCESS)
+    return;
+
+  std::vector<std::vector<unsigned char> > binaries(m_device_count);
+  std::vector<unsigned char*> pointers(m_device_count);
+  for(cl_uint i = 0; i < m_device_count; ++i)
+  {
+    if(sizes[i] == 0)
+      return;
+    binaries[i].resize(sizes[i]);
+    pointers[i] = &binaries[i][0];
+  }
+  if(clGetProgramInfo(_program, CL_PROGRAM_BINARIES, sizeof(unsigned char*) * pointers.size(), &pointers[0], NULL) != CL_SUCCESS)
+    return;
+
+  // A missing cache only costs a rebuild, so failures here are ignored
+  #ifdef _WIN32
+    _mkdir(m_cache.c_str());
+  #else
+    mkdir(m_cache.c_str(), 0755);
+  #endif
+
+  // Written next to the final name and renamed so readers never see part of a file
+  const std::string temporary = _filepath + ".tmp";
+  {
+    std::ofstream file(temporary.c_str(), std::ios::binary);
+    const unsigned long long key_size = _key.size();
+    const cl_uint count = m_device_count;
+    file.write(PROGRAM_CACHE_MAGIC, 8);
+    file.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+    file.write(_key.data(), _key.size());
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for(cl_uint i = 0; i < count; ++i)
+    {
+      const unsigned long long size = sizes[i];
+      file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+      file.write(reinterpret_cast<const char*>(&binaries[i][0]), size);
+    }
+    if(!file)
+    {
+      file.close();
+      std::remove(temporary.c_str());
+      return;
+    }
+  }
+  std::rename(temporary.c_str(), _filepath.c_str());
+}
+
+void ClEnvironment::partitionDevices()
+{
+  std::vector<cl_device_id> sub_devices;
+  for(cl_uint i = 0; i < m_device_count; ++i)
+  {
+    const cl_device_partition_property properties[] = {CL_DEVICE_PARTITION_EQUALLY, static_cast<cl_device_partition_property>(m_partition), 0};
+    cl_uint count = 0;
+    if(clCreateSubDevices(m_device_ids[i], properties, 0, NULL, &count) != CL_SUCCESS || count == 0)
+    {
+      std::cout << "Device " << device_string(m_device_ids[i], CL_DEVICE_NAME) << " cannot be partitioned into sub-devices of " << m_partition << " compute units." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+    const std::size_t first = sub_devices.size();
+    sub_devices.resize(first + count);
+    opencl_error_check(clCreateSubDevices(m_device_ids[i], properties, count, &sub_devices[first], NULL));
+  }
+
+  // Sub-devices replace their parents everywhere, including the context
+  delete[] m_device_ids;
+  m_device_count = sub_devices.size();
+  m_device_ids = new cl_device_id[m_device_count];
+  std::copy(sub_devices.begin(), sub_devices.end(), m_device_ids);
+}
+
+void ClEnvironment::createContext(Framebuffer *_framebuffer)
+{
+  // OpenCL setup
+  cl_uint platform_count = 0;
+  clGetPlatformIDs(1, &m_platform_id, &platform_count);
+  if(platform_count == 0)
+  {
+    std::cout << "No OpenCL platform found, use --backend cpu instead." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // Headless runs may use any device type, display needs a GPU sharing with GL
+  cl_device_type device_type = CL_DEVICE_TYPE_GPU;
+  m_device_count = 0;
+  clGetDeviceIDs(m_platform_id, device_type, 0, NULL, &m_device_count);
+  if(m_device_count == 0 && _framebuffer == NULL)
+  {
+    device_type = CL_DEVICE_TYPE_ALL;
+    clGetDeviceIDs(m_platform_id, device_type, 0, NULL, &m_device_count);
+  }
+  if(m_device_count == 0)
+  {
+    std::cout << "No OpenCL devices found." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  m_device_ids = new cl_device_id[m_device_count];
+  clGetDeviceIDs(m_platform_id, device_type, m_device_count, m_device_ids, NULL);
+
+  if(_framebuffer != NULL)
+    m_partition = 0;
+  if(m_partition > 0)
+    partitionDevices();
+
+  // Error code
+  cl_int error = CL_SUCCESS;
+
+  if(_framebuffer == NULL)
+  {
+    const cl_context_properties context_properties[] = {
+      CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(m_platform_id),
+      0
+    };
+
+    m_context = clCreateContext(context_properties, m_device_count, m_device_ids, NULL, NULL, &error);
+    opencl_error_check(error);
+    return;
+  }
+
+  #ifdef __APPLE__
+    CGLContextObj cgl_context = CGLGetCurrentContext();
+    CGLShareGroupObj sharegroup = CGLGetShareGroup(cgl_context);
+
+    const cl_context_properties context_properties[] = {
+      CL_CONTEXT_PROPERTY_USE_CGL_SHAREGROUP_APPLE, (cl_context_properties)sharegroup,
+      CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(m_platform_id),
+      0
+    };
+  #elif __linux__
+    const cl_context_properties context_properties[] = {
+      CL_GL_CONTEXT_KHR, (cl_context_properties)glXGetCurrentContext(),
+      CL_GLX_DISPLAY_KHR, (cl_context_properties)glXGetCurrentDisplay(),
+      CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(m_platform_id),
+      0
+    };
+  #elif _WIN32
+    const cl_context_properties context_properties[] = {
+      CL_GL_CONTEXT_KHR, (cl_context_properties)wglGetCurrentContext(),
+      CL_WGL_HDC_KHR, (cl_context_properties)wglGetCurrentDC(),
+      CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(m_platform_id),
+      0
+    };
+  #endif
+
+  // Context creation
+  m_context = clCreateContext(context_properties, m_device_count, m_device_ids, NULL, NULL, &error);
+  opencl_error_check(error);
+}
\ No newline at end of file
@@ -0,0 +1,1106 @@
+#include <ClSolver.h>
+#include <Utility.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void release_event(cl_event *_event)
+{
+  if(*_event != NULL)
+    clReleaseEvent(*_event);
+  *_event = NULL;
+}
+
+ClSolver::ClSolver(const Grid &_grid, const InputData &_input, const float *_a, const float *_b, const Options &_options, Framebuffer *_framebuffer)
+  : m_grid(_grid)
+  , m_iteration(0)
+  , m_source(0)
+  , m_input(_input)
+  , m_storage(storage_from_name(_options.storage))
+  , m_layout(layout_from_name(_options.layout))
+  , m_specialize(_options.specialize)
+  , m_profiler(NULL)
+  , m_display_queue(NULL)
+  , m_step_begin(NULL)
+  , m_stepped(NULL)
+  , m_presented(NULL)
+  , m_presented_source(0)
+  , m_released(NULL)
+  , m_display_begin(NULL)
+  , m_display_end(NULL)
+  , m_event(NULL)
+  , m_image(NULL)
+  , m_parameters(NULL)
+  , m_uploaded(NULL)
+  , m_map(NULL)
+  , m_map_f(!_options.map_f.empty())
+  , m_map_k(!_options.map_k.empty())
+  , m_integrator(integrator_from_name(_options.integrator))
+  , m_sum(NULL)
+  , m_use_volume(_grid.depth > 1)
+  , m_stencil(_options.stencil)
+  , m_slice(_options.slice < 0 ? _grid.depth / 2 : _options.slice)
+  , m_adaptive(_options.adaptive)
+  , m_adapt_target(_options.adapt_target)
+  , m_since_adapt(0)
+  , m_time(0.0)
+  , m_change(NULL)
+  , m_active_tiles(_options.active_tiles)
+  , m_active_threshold(_options.active_threshold)
+  , m_active_interval(1)
+  , m_since_active(0)
+  , m_active_count(0)
+  , m_mask(NULL)
+  , m_tile_list(NULL)
+  , m_tile_count(NULL)
+  , m_listed(NULL)
+  , m_use_tiled(_options.kernel == "tiled")
+  , m_block(_options.block)
+  , m_downsample(std::max(1u, _options.downsample))
+{
+  m_environment = new ClEnvironment(_framebuffer, _options.kernel_cache);
+  m_context = m_environment->context();
+  m_device = m_environment->device();
+
+  // Error code
+  cl_int error = CL_SUCCESS;
+  const std::size_t bytes = storage_bytes(m_storage) * m_grid.size();
+
+  // Fields in another format are converted on the host before the upload
+  std::vector<char> fields;
+  const void *a = _a;
+  const void *b = _b;
+  if(m_storage != STORAGE_FP32 || m_layout != LAYOUT_PLANAR)
+  {
+    fields.resize(2 * bytes);
+    pack_fields(m_storage, m_layout, _a, _b, &fields[0], m_grid.size());
+    a = &fields[0];
+    b = &fields[bytes];
+  }
+
+  // Memory allocation, buffers are fully written by the first step
+  if(m_layout == LAYOUT_INTERLEAVED)
+  {
+    // The a buffers hold both fields and stand in for the b buffers too
+    m_current_a = clCreateBuffer(m_context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, 2 * bytes, const_cast<void*>(a), &error);
+    opencl_error_check(error);
+    m_buffer_a = clCreateBuffer(m_context, CL_MEM_READ_WRITE, 2 * bytes, NULL, &error);
+    opencl_error_check(error);
+    m_current_b = m_current_a;
+    m_buffer_b = m_buffer_a;
+    clRetainMemObject(m_current_b);
+    clRetainMemObject(m_buffer_b);
+  }
+  else
+  {
+    m_current_a = clCreateBuffer(m_context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, bytes, const_cast<void*>(a), &error);
+    opencl_error_check(error);
+    m_current_b = clCreateBuffer(m_context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, bytes, const_cast<void*>(b), &error);
+    opencl_error_check(error);
+    m_buffer_a = clCreateBuffer(m_context, CL_MEM_READ_WRITE, bytes, NULL, &error);
+    opencl_error_check(error);
+    m_buffer_b = clCreateBuffer(m_context, CL_MEM_READ_WRITE, bytes, NULL, &error);
+    opencl_error_check(error);
+  }
+
+  if(_framebuffer != NULL)
+  {
+    m_image = clCreateFromGLTexture(m_context, CL_MEM_WRITE_ONLY, GL_TEXTURE_2D, 0, _framebuffer->texture(), &error);
+    opencl_error_check(error);
+  }
+
+  // Volumes have a kernel of their own, a tiled forward Euler step
+  if(m_use_volume)
+  {
+    if(m_integrator != INTEGRATOR_EULER || m_adaptive)
+    {
+      std::cout << "Volumes are only stepped with the euler integrator and a fixed delta." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if(m_slice >= m_grid.depth)
+    {
+      std::cout << "Slice " << m_slice << " is outside the volume of depth " << m_grid.depth << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if(m_block > 1 || m_active_tiles)
+    {
+      std::cout << "Volumes are stepped one step and every tile per launch, --block and --active-tiles are ignored." << std::endl;
+      m_block = 1;
+      m_active_tiles = false;
+    }
+  }
+
+  // Runge-Kutta stage states and their sum are kept in fp32 a/b pairs
+  m_stages[0] = NULL;
+  m_stages[1] = NULL;
+  if(m_integrator != INTEGRATOR_EULER)
+  {
+    for(int i = 0; i < 2; ++i)
+    {
+      m_stages[i] = clCreateBuffer(m_context, CL_MEM_READ_WRITE, 2 * sizeof(float) * m_grid.size(), NULL, &error);
+      opencl_error_check(error);
+    }
+    m_sum = clCreateBuffer(m_context, CL_MEM_READ_WRITE, 2 * sizeof(float) * m_grid.size(), NULL, &error);
+    opencl_error_check(error);
+  }
+
+  // Adaptive stepping starts within the stability bound and changes delta
+  // too often for it to be folded into the program
+  if(m_adaptive)
+  {
+    m_change = clCreateBuffer(m_context, CL_MEM_READ_WRITE, sizeof(cl_uint), NULL, &error);
+    opencl_error_check(error);
+    m_input.delta = std::min(m_input.delta, ADAPT_SAFETY * stable_delta(m_input, m_integrator, spectralRadius()));
+    if(m_specialize == "all")
+    {
+      std::cout << "Adaptive stepping changes delta, the program is only specialized on the grid." << std::endl;
+      m_specialize = "grid";
+    }
+  }
+  else
+  {
+    checkStability();
+  }
+
+  // Tiles are the work-groups of the tiled Euler kernel
+  if(m_active_tiles && (!m_use_tiled || m_block > 1 || m_integrator != INTEGRATOR_EULER))
+  {
+    std::cout << "Active tiles need the tiled kernel without --block or a Runge-Kutta integrator, every tile is stepped." << std::endl;
+    m_active_tiles = false;
+  }
+  if(m_active_tiles)
+  {
+    const std::size_t tiles = ((m_grid.width + _options.local_x - 1) / _options.local_x) * ((m_grid.height + _options.local_y - 1) / _options.local_y);
+    m_mask = clCreateBuffer(m_context, CL_MEM_READ_WRITE, tiles, NULL, &error);
+    opencl_error_check(error);
+    m_tile_list = clCreateBuffer(m_context, CL_MEM_READ_WRITE, sizeof(cl_uint) * tiles, NULL, &error);
+    opencl_error_check(error);
+    m_tile_count = clCreateBuffer(m_context, CL_MEM_READ_WRITE, sizeof(cl_uint), NULL, &error);
+    opencl_error_check(error);
+    m_listed = clCreateBuffer(m_context, CL_MEM_READ_WRITE, tiles, NULL, &error);
+    opencl_error_check(error);
+  }
+
+  // Coefficients are read from constant memory, so changing them needs no new
+  // kernel arguments, only an upload
+  m_upload = m_input;
+  m_parameters = clCreateBuffer(m_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(InputData), &m_upload, &error);
+  opencl_error_check(error);
+  createMap(_options);
+
+  m_program = m_environment->build("kernels/image.cl", buildOptions());
+  createKernels();
+
+  // One work-item per pixel of the displayed image
+  m_display[0] = (m_grid.width + m_downsample - 1) / m_downsample;
+  m_display[1] = (m_grid.height + m_downsample - 1) / m_downsample;
+
+  // Create queue, with event timings only when profiling
+  m_queue = m_environment->createQueue(_options.profile ? CL_QUEUE_PROFILING_ENABLE : 0);
+  if(_options.pipeline && m_image != NULL)
+    m_display_queue = m_environment->createQueue(_options.profile ? CL_QUEUE_PROFILING_ENABLE : 0);
+
+  setupLocal(_options);
+}
+
+ClSolver::~ClSolver()
+{
+  if(m_display_queue != NULL)
+  {
+    clFinish(m_display_queue);
+    clReleaseCommandQueue(m_display_queue);
+  }
+  release_event(&m_step_begin);
+  release_event(&m_stepped);
+  release_event(&m_presented);
+  release_event(&m_released);
+  release_event(&m_display_begin);
+  release_event(&m_display_end);
+
+  // The staging copy of the coefficients must outlive their last upload
+  if(m_uploaded != NULL)
+    clWaitForEvents(1, &m_uploaded);
+  release_event(&m_uploaded);
+  if(m_map != NULL)
+    clReleaseMemObject(m_map);
+  clReleaseMemObject(m_parameters);
+  clReleaseCommandQueue(m_queue);
+  releaseKernels();
+  if(m_image != NULL)
+    clReleaseMemObject(m_image);
+  if(m_change != NULL)
+    clReleaseMemObject(m_change);
+  if(m_mask != NULL)
+  {
+    clReleaseMemObject(m_listed);
+    clReleaseMemObject(m_tile_count);
+    clReleaseMemObject(m_tile_list);
+    clReleaseMemObject(m_mask);
+  }
+  if(m_sum != NULL)
+  {
+    clReleaseMemObject(m_sum);
+    clReleaseMemObject(m_stages[1]);
+    clReleaseMemObject(m_stages[0]);
+  }
+  clReleaseMemObject(m_buffer_b);
+  clReleaseMemObject(m_buffer_a);
+  clReleaseMemObject(m_current_b);
+  clReleaseMemObject(m_current_a);
+  clReleaseProgram(m_program);
+  delete m_environment;
+}
+
+void ClSolver::step(const unsigned int _count)
+{
+  // Pipelined steps are bracketed by markers, the first only to measure overlap
+  if(m_display_queue != NULL && m_profiler != NULL)
+  {
+    release_event(&m_step_begin);
+    opencl_error_check(clEnqueueMarkerWithWaitList(m_queue, 0, NULL, &m_step_begin));
+  }
+
+  for(unsigned int done = 0; done < _count;)
+  {
+    const unsigned int steps = launch(_count - done, done == 0);
+    done += steps;
+
+    // Tiles are listed again before a change of delta might wake them all
+    m_since_active += steps;
+    if(m_active_tiles && m_since_active >= m_active_interval)
+    {
+      updateActive();
+      m_since_active = 0;
+    }
+
+    m_since_adapt += steps;
+    if(m_adaptive && m_since_adapt >= ADAPT_INTERVAL)
+    {
+      adapt(steps);
+      m_since_adapt = 0;
+    }
+  }
+
+  if(m_display_queue == NULL)
+    return;
+
+  // The next present waits on these steps alone, not on anything queued after them
+  release_event(&m_stepped);
+  opencl_error_check(clEnqueueMarkerWithWaitList(m_queue, 0, NULL, &m_stepped));
+  clFlush(m_queue);
+
+  if(m_display_begin != NULL)
+  {
+    clRetainEvent(m_step_begin);
+    clRetainEvent(m_stepped);
+    m_profiler->overlap(m_display_begin, m_display_end, m_step_begin, m_stepped);
+    m_display_begin = NULL;
+    m_display_end = NULL;
+  }
+}
+
+void ClSolver::parameters(const InputData &_input)
+{
+  // Adaptive stepping owns delta and only keeps it within the new bound
+  InputData input = _input;
+  if(m_adaptive)
+    input.delta = std::min(m_input.delta, ADAPT_SAFETY * stable_delta(input, m_integrator, spectralRadius()));
+
+  if(memcmp(&input, &m_input, sizeof(InputData)) == 0)
+    return;
+  m_input = input;
+  if(!m_adaptive)
+    checkStability();
+
+  // Coefficients folded into the program need a rebuild, which is usually a cache hit
+  if(m_specialize == "all")
+  {
+    finish();
+    releaseKernels();
+    clReleaseProgram(m_program);
+    m_program = m_environment->build("kernels/image.cl", buildOptions());
+    createKernels();
+    setLocalArguments();
+  }
+  else
+  {
+    setInput();
+  }
+
+  // Settled tiles may start changing under new coefficients
+  if(m_active_tiles)
+    activateAll();
+}
+
+void ClSolver::present()
+{
+  if(m_image == NULL)
+    return;
+
+  if(m_display_queue != NULL)
+  {
+    presentPipelined();
+    return;
+  }
+
+  // The shared image is only held by OpenCL while the colormap writes it
+  clEnqueueAcquireGLObjects(m_queue, 1, &m_image, 0, NULL, event());
+  profiled(PROFILE_ACQUIRE);
+
+  cl_int error = clEnqueueNDRangeKernel(m_queue, m_colormap[m_source], 2, NULL, m_display, NULL, 0, NULL, event());
+  opencl_error_check(error);
+  profiled(PROFILE_COLORMAP);
+
+  // Release image
+  clEnqueueReleaseGLObjects(m_queue, 1, &m_image, 0, NULL, event());
+  profiled(PROFILE_RELEASE);
+}
+
+void ClSolver::read(float *_a, float *_b)
+{
+  // Every launch swaps buffers, whatever the number of iterations it fused
+  cl_mem a = m_source ? m_buffer_a : m_current_a;
+  cl_mem b = m_source ? m_buffer_b : m_current_b;
+  const std::size_t bytes = storage_bytes(m_storage) * m_grid.size();
+
+  if(m_storage == STORAGE_FP32 && m_layout == LAYOUT_PLANAR)
+  {
+    opencl_error_check(clEnqueueReadBuffer(m_queue, a, CL_TRUE, 0, bytes, _a, 0, NULL, event()));
+    profiled(PROFILE_READ);
+    opencl_error_check(clEnqueueReadBuffer(m_queue, b, CL_TRUE, 0, bytes, _b, 0, NULL, event()));
+    profiled(PROFILE_READ);
+    return;
+  }
+
+  std::vector<char> fields(2 * bytes);
+  if(m_layout == LAYOUT_INTERLEAVED)
+  {
+    opencl_error_check(clEnqueueReadBuffer(m_queue, a, CL_TRUE, 0, 2 * bytes, &fields[0], 0, NULL, event()));
+    profiled(PROFILE_READ);
+  }
+  else
+  {
+    opencl_error_check(clEnqueueReadBuffer(m_queue, a, CL_TRUE, 0, bytes, &fields[0], 0, NULL, event()));
+    profiled(PROFILE_READ);
+    opencl_error_check(clEnqueueReadBuffer(m_queue, b, CL_TRUE, 0, bytes, &fields[bytes], 0, NULL, event()));
+    profiled(PROFILE_READ);
+  }
+  unpack_fields(m_storage, m_layout, &fields[0], _a, _b, m_grid.size());
+}
+
+void ClSolver::presentPipelined()
+{
+  // A colormap no step had to wait on may still read the other buffer
+  if(m_presented != NULL && m_presented_source != m_source)
+    opencl_error_check(clEnqueueBarrierWithWaitList(m_queue, 1, &m_presented, NULL));
+  release_event(&m_presented);
+  release_event(&m_released);
+
+  const cl_uint waits = m_stepped != NULL ? 1 : 0;
+  cl_event acquired = NULL;
+  opencl_error_check(clEnqueueAcquireGLObjects(m_display_queue, 1, &m_image, waits, waits ? &m_stepped : NULL, &acquired));
+  opencl_error_check(clEnqueueNDRangeKernel(m_display_queue, m_colormap[m_source], 2, NULL, m_display, NULL, 0, NULL, &m_presented));
+  opencl_error_check(clEnqueueReleaseGLObjects(m_display_queue, 1, &m_image, 0, NULL, &m_released));
+  m_presented_source = m_source;
+  clFlush(m_display_queue);
+
+  if(m_profiler == NULL)
+  {
+    clReleaseEvent(acquired);
+    return;
+  }
+
+  // The profiler and the overlap with the next steps hold references of their own
+  release_event(&m_display_begin);
+  release_event(&m_display_end);
+  clRetainEvent(acquired);
+  clRetainEvent(m_presented);
+  clRetainEvent(m_released);
+  clRetainEvent(m_released);
+  m_display_begin = acquired;
+  m_display_end = m_released;
+  m_profiler->record(PROFILE_ACQUIRE, acquired);
+  m_profiler->record(PROFILE_COLORMAP, m_presented);
+  m_profiler->record(PROFILE_RELEASE, m_released);
+}
+
+void ClSolver::waitPresent()
+{
+  if(m_display_queue == NULL)
+  {
+    clFinish(m_queue);
+    return;
+  }
+  if(m_released != NULL)
+    opencl_error_check(clWaitForEvents(1, &m_released));
+}
+
+void ClSolver::finish()
+{
+  clFinish(m_queue);
+  if(m_display_queue != NULL)
+    clFinish(m_display_queue);
+}
+
+unsigned int ClSolver::iteration() const
+{
+  return m_iteration;
+}
+
+void ClSolver::resume(const unsigned int _iteration)
+{
+  m_iteration = _iteration;
+}
+
+void ClSolver::snapshot(cl_mem _fields, cl_event *_event)
+{
+  cl_mem a = m_source ? m_buffer_a : m_current_a;
+  cl_mem b = m_source ? m_buffer_b : m_current_b;
+  const std::size_t bytes = storage_bytes(m_storage) * m_grid.size();
+
+  // The queue is in order so the second copy's event covers both
+  if(m_layout == LAYOUT_INTERLEAVED)
+  {
+    opencl_error_check(clEnqueueCopyBuffer(m_queue, a, _fields, 0, 0, 2 * bytes, 0, NULL, _event));
+  }
+  else
+  {
+    opencl_error_check(clEnqueueCopyBuffer(m_queue, a, _fields, 0, 0, bytes, 0, NULL, NULL));
+    opencl_error_check(clEnqueueCopyBuffer(m_queue, b, _fields, 0, bytes, bytes, 0, NULL, _event));
+  }
+  clFlush(m_queue);
+}
+
+const Grid& ClSolver::grid() const
+{
+  return m_grid;
+}
+
+const ClEnvironment* ClSolver::environment() const
+{
+  return m_environment;
+}
+
+Storage ClSolver::storage() const
+{
+  return m_storage;
+}
+
+Layout ClSolver::layout() const
+{
+  return m_layout;
+}
+
+double ClSolver::time() const
+{
+  return m_time;
+}
+
+float ClSolver::delta() const
+{
+  return m_input.delta;
+}
+
+unsigned int ClSolver::activeTiles() const
+{
+  return m_active_tiles ? m_active_count : tiles();
+}
+
+unsigned int ClSolver::tiles() const
+{
+  return (m_global[0] / m_local[0]) * (m_global[1] / m_local[1]);
+}
+
+void ClSolver::profile(Profiler *_profiler)
+{
+  m_profiler = _profiler;
+}
+
+cl_event* ClSolver::event()
+{
+  return m_profiler != NULL ? &m_event : NULL;
+}
+
+void ClSolver::profiled(const ProfileStage _stage, const unsigned int _steps)
+{
+  // The profiler takes over the event written by the last command
+  if(m_profiler != NULL)
+    m_profiler->record(_stage, m_event, _steps);
+}
+
+void ClSolver::waitColormap()
+{
+  // Launches write the buffer not holding the latest state, which is the one
+  // the colormap reads as soon as one launch followed the present
+  if(m_presented == NULL || m_source == m_presented_source)
+    return;
+  opencl_error_check(clEnqueueBarrierWithWaitList(m_queue, 1, &m_presented, NULL));
+  release_event(&m_presented);
+}
+
+unsigned int ClSolver::launch(const unsigned int _remaining, const bool _sampled)
+{
+  std::size_t size[] = {m_grid.size()};
+  unsigned int steps = 1;
+  bool sampled = _sampled;
+  bool swap = true;
+  cl_int error = CL_SUCCESS;
+  waitColormap();
+
+  // Whole blocks of Euler iterations are fused into single launches
+  if(m_integrator != INTEGRATOR_EULER)
+  {
+    launchStages(_sampled);
+  }
+  else if(m_use_volume)
+  {
+    error = clEnqueueNDRangeKernel(m_queue, m_volume[m_source], 3, NULL, m_volume_global, m_volume_local, 0, NULL, _sampled ? event() : NULL);
+  }
+  else if(m_block > 1 && _remaining >= m_block)
+  {
+    error = clEnqueueNDRangeKernel(m_queue, m_blocked[m_source], 2, NULL, m_global, m_local, 0, NULL, _sampled ? event() : NULL);
+    steps = m_block;
+  }
+  else if(m_active_tiles)
+  {
+    // Tiles left out of the list hold the same fields in both buffers, so
+    // without any listed tile the latest buffer stays where it is
+    std::size_t active[] = {m_local[0] * m_active_count, m_local[1]};
+    if(m_active_count > 0)
+      error = clEnqueueNDRangeKernel(m_queue, m_active[m_source], 2, NULL, active, m_local, 0, NULL, _sampled ? event() : NULL);
+    sampled = _sampled && m_active_count > 0;
+    swap = m_active_count > 0;
+  }
+  else if(m_use_tiled)
+  {
+    error = clEnqueueNDRangeKernel(m_queue, m_tiled[m_source], 2, NULL, m_global, m_local, 0, NULL, _sampled ? event() : NULL);
+  }
+  else
+  {
+    error = clEnqueueNDRangeKernel(m_queue, m_simulate[m_source], 1, NULL, size, NULL, 0, NULL, _sampled ? event() : NULL);
+  }
+  opencl_error_check(error);
+
+  if(sampled)
+    profiled(PROFILE_STEP, steps);
+  if(swap)
+    m_source = 1 - m_source;
+  m_iteration += steps;
+  m_time += static_cast<double>(m_input.delta) * steps;
+  return steps;
+}
+
+void ClSolver::launchStages(const bool _sampled)
+{
+  // Stages alternate between the two state buffers, only the first is timed
+  std::size_t size[] = {static_cast<std::size_t>(m_grid.width), static_cast<std::size_t>(m_grid.height)};
+  const int stages = integrator_stages(m_integrator);
+  cl_kernel kernel = m_stage[m_source];
+  for(int s = 0; s < stages; ++s)
+  {
+    const cl_int first = s == 0;
+    const cl_int last = s == stages - 1;
+    const float weight = stage_weight(m_integrator, s);
+    const float scale = stage_scale(m_integrator, s);
+
+    clSetKernelArg(kernel, 8, sizeof(cl_mem), &m_stages[(s + 1) % 2]);
+    clSetKernelArg(kernel, 9, sizeof(cl_mem), &m_stages[s % 2]);
+    clSetKernelArg(kernel, 11, sizeof(cl_int), &first);
+    clSetKernelArg(kernel, 12, sizeof(cl_int), &last);
+    clSetKernelArg(kernel, 13, sizeof(float), &weight);
+    clSetKernelArg(kernel, 14, sizeof(float), &scale);
+
+    cl_int error = clEnqueueNDRangeKernel(m_queue, kernel, 2, NULL, size, NULL, 0, NULL, _sampled && s == 0 ? event() : NULL);
+    opencl_error_check(error);
+  }
+}
+
+void ClSolver::adapt(const unsigned int _steps)
+{
+  // The two field buffers hold the states before and after the last launch
+  const cl_uint zero = 0;
+  cl_uint bits = 0;
+  opencl_error_check(clEnqueueFillBuffer(m_queue, m_change, &zero, sizeof(zero), 0, sizeof(zero), 0, NULL, NULL));
+  opencl_error_check(clEnqueueNDRangeKernel(m_queue, m_change_max, 2, NULL, m_global, m_local, 0, NULL, NULL));
+  opencl_error_check(clEnqueueReadBuffer(m_queue, m_change, CL_TRUE, 0, sizeof(bits), &bits, 0, NULL, NULL));
+
+  // Fused launches spread their change over their steps
+  float change = 0.f;
+  memcpy(&change, &bits, sizeof(change));
+  const float limit = ADAPT_SAFETY * stable_delta(m_input, m_integrator, spectralRadius());
+  const float delta = adapt_delta(m_input.delta, change / _steps, m_adapt_target, limit);
+  if(delta == m_input.delta)
+    return;
+
+  m_input.delta = delta;
+  setInput();
+  if(m_active_tiles)
+    activateAll();
+}
+
+void ClSolver::setInput()
+{
+  // The queue is in order, launches before the upload still see the old values
+  if(m_uploaded != NULL)
+  {
+    opencl_error_check(clWaitForEvents(1, &m_uploaded));
+    release_event(&m_uploaded);
+  }
+  m_upload = m_input;
+  opencl_error_check(clEnqueueWriteBuffer(m_queue, m_parameters, CL_FALSE, 0, sizeof(InputData), &m_upload, 0, NULL, &m_uploaded));
+}
+
+void ClSolver::createMap(const Options &_options)
+{
+  if(!m_map_f && !m_map_k)
+    return;
+
+  // Coefficients taken from the map cannot be folded into the program
+  if(m_specialize == "all")
+  {
+    std::cout << "Parameter maps vary f or k per cell, the program is only specialized on the grid." << std::endl;
+    m_specialize = "grid";
+  }
+
+  float f_from = m_input.f, f_to = m_input.f;
+  float k_from = m_input.k, k_to = m_input.k;
+  if(m_map_f)
+    sscanf(_options.map_f.c_str(), "%f:%f", &f_from, &f_to);
+  if(m_map_k)
+    sscanf(_options.map_k.c_str(), "%f:%f", &k_from, &k_to);
+
+  // Linear ramps over the plane, padding cells take the value of the last column
+  std::vector<float> map(2 * m_grid.plane());
+  for(int y = 0; y < m_grid.height; ++y)
+  {
+    const float f = f_from + (f_to - f_from) * y / (m_grid.height - 1);
+    for(int x = 0; x < m_grid.stride; ++x)
+    {
+      const std::size_t i = static_cast<std::size_t>(y) * m_grid.stride + x;
+      map[2 * i] = f;
+      map[2 * i + 1] = k_from + (k_to - k_from) * std::min(x, m_grid.width - 1) / (m_grid.width - 1);
+    }
+  }
+
+  cl_int error = CL_SUCCESS;
+  m_map = clCreateBuffer(m_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * map.size(), &map[0], &error);
+  opencl_error_check(error);
+}
+
+void ClSolver::setMapArguments()
+{
+  // Programs built without a map never read it, a NULL buffer is passed then
+  for(int i = 0; i < 2; ++i)
+  {
+    clSetKernelArg(m_simulate[i], 8, sizeof(cl_mem), &m_map);
+    clSetKernelArg(m_tiled[i], 10, sizeof(cl_mem), &m_map);
+    clSetKernelArg(m_blocked[i], 13, sizeof(cl_mem), &m_map);
+    if(m_volume[i] != NULL)
+      clSetKernelArg(m_volume[i], 12, sizeof(cl_mem), &m_map);
+    if(m_active[i] != NULL)
+      clSetKernelArg(m_active[i], 12, sizeof(cl_mem), &m_map);
+    if(m_stage[i] != NULL)
+      clSetKernelArg(m_stage[i], 15, sizeof(cl_mem), &m_map);
+  }
+}
+
+void ClSolver::updateActive()
+{
+  // The two field buffers hold the states before and after the last step
+  opencl_error_check(clEnqueueNDRangeKernel(m_queue, m_tile_activity, 2, NULL, m_global, m_local, 0, NULL, NULL));
+  compactTiles();
+
+  // Tiles whose last change was below a non-zero threshold still differ
+  // between the buffers, the next step's destination takes the latest state.
+  // With a zero threshold they are already identical.
+  if(m_active_threshold > 0.f)
+  {
+    cl_mem a_latest = m_source ? m_buffer_a : m_current_a;
+    cl_mem b_latest = m_source ? m_buffer_b : m_current_b;
+    cl_mem a_next = m_source ? m_current_a : m_buffer_a;
+    cl_mem b_next = m_source ? m_current_b : m_buffer_b;
+    clSetKernelArg(m_copy_settled, 0, sizeof(cl_mem), &a_next);
+    clSetKernelArg(m_copy_settled, 1, sizeof(cl_mem), &b_next);
+    clSetKernelArg(m_copy_settled, 2, sizeof(cl_mem), &a_latest);
+    clSetKernelArg(m_copy_settled, 3, sizeof(cl_mem), &b_latest);
+    opencl_error_check(clEnqueueNDRangeKernel(m_queue, m_copy_settled, 2, NULL, m_global, m_local, 0, NULL, NULL));
+  }
+
+  opencl_error_check(clEnqueueReadBuffer(m_queue, m_tile_count, CL_TRUE, 0, sizeof(m_active_count), &m_active_count, 0, NULL, NULL));
+}
+
+void ClSolver::activateAll()
+{
+  const cl_uchar active = 1;
+  opencl_error_check(clEnqueueFillBuffer(m_queue, m_mask, &active, sizeof(active), 0, tiles(), 0, NULL, NULL));
+  compactTiles();
+  m_active_count = tiles();
+}
+
+void ClSolver::compactTiles()
+{
+  const cl_uint zero = 0;
+  std::size_t size[] = {tiles()};
+  opencl_error_check(clEnqueueFillBuffer(m_queue, m_tile_count, &zero, sizeof(zero), 0, sizeof(zero), 0, NULL, NULL));
+  opencl_error_check(clEnqueueNDRangeKernel(m_queue, m_compact_tiles, 1, NULL, size, NULL, 0, NULL, NULL));
+}
+
+void ClSolver::checkStability() const
+{
+  const float limit = stable_delta(m_input, m_integrator, spectralRadius());
+  if(m_input.delta > limit)
+    std::cout << "Warning: delta " << m_input.delta << " is above the stability bound " << limit << " of these coefficients, --adaptive keeps it stable" << std::endl;
+}
+
+float ClSolver::spectralRadius() const
+{
+  if(!m_use_volume)
+    return STENCIL_SPECTRAL_RADIUS;
+  return m_stencil == 27 ? VOLUME_27_SPECTRAL_RADIUS : VOLUME_7_SPECTRAL_RADIUS;
+}
+
+void ClSolver::setArguments(cl_kernel _kernel, cl_mem _a_current, cl_mem _b_current, cl_mem _a_buffer, cl_mem _b_buffer)
+{
+  // Resolution for kernel
+  const float width = m_grid.width;
+  const float height = m_grid.height;
+  const cl_int stride = m_grid.stride;
+
+  clSetKernelArg(_kernel, 0, sizeof(cl_mem), &_a_current);
+  clSetKernelArg(_kernel, 1, sizeof(cl_mem), &_b_current);
+  clSetKernelArg(_kernel, 2, sizeof(cl_mem), &_a_buffer);
+  clSetKernelArg(_kernel, 3, sizeof(cl_mem), &_b_buffer);
+  clSetKernelArg(_kernel, 4, sizeof(cl_mem), &m_parameters);
+  clSetKernelArg(_kernel, 5, sizeof(float), &width);
+  clSetKernelArg(_kernel, 6, sizeof(float), &height);
+  clSetKernelArg(_kernel, 7, sizeof(cl_int), &stride);
+}
+
+std::string ClSolver::buildOptions() const
+{
+  std::string options = storage_define(m_storage) + " " + layout_define(m_layout);
+  if(m_stencil == 27)
+    options += " -DVOLUME_STENCIL_27";
+  if(m_map_f)
+    options += " -DMAP_F";
+  if(m_map_k)
+    options += " -DMAP_K";
+  if(m_specialize == "none")
+    return options;
+
+  // Constant grid dimensions let the compiler fold the indexing and wrap logic
+  char defines[256];
+  snprintf(defines, sizeof(defines), " -DGRID_WIDTH=%d -DGRID_HEIGHT=%d -DGRID_STRIDE=%d -DGRID_DEPTH=%d", m_grid.width, m_grid.height, m_grid.stride, m_grid.depth);
+  options += defines;
+  if(m_specialize != "all")
+    return options;
+
+  // Coefficients as hexadecimal literals so the folded values are bit exact
+  snprintf(defines, sizeof(defines), " -DFIXED_INPUT -DINPUT_Da=%af -DINPUT_Db=%af -DINPUT_f=%af -DINPUT_k=%af -DINPUT_delta=%af",
+    m_input.Da, m_input.Db, m_input.f, m_input.k, m_input.delta);
+  return options + defines;
+}
+
+void ClSolver::createKernels()
+{
+  // Error code
+  cl_int error = CL_SUCCESS;
+
+  for(int i = 0; i < 2; ++i)
+  {
+    cl_mem a_current = i ? m_current_a : m_buffer_a;
+    cl_mem b_current = i ? m_current_b : m_buffer_b;
+    cl_mem a_buffer = i ? m_buffer_a : m_current_a;
+    cl_mem b_buffer = i ? m_buffer_b : m_current_b;
+
+    m_simulate[i] = clCreateKernel(m_program, "simulate", &error);
+    opencl_error_check(error);
+    setArguments(m_simulate[i], a_current, b_current, a_buffer, b_buffer);
+
+    m_tiled[i] = clCreateKernel(m_program, "simulate_tiled", &error);
+    opencl_error_check(error);
+    setArguments(m_tiled[i], a_current, b_current, a_buffer, b_buffer);
+
+    m_blocked[i] = clCreateKernel(m_program, "simulate_blocked", &error);
+    opencl_error_check(error);
+    setArguments(m_blocked[i], a_current, b_current, a_buffer, b_buffer);
+
+    m_volume[i] = NULL;
+    if(m_use_volume)
+    {
+      const cl_int depth = m_grid.depth;
+      const cl_int slab = VOLUME_SLAB;
+
+      m_volume[i] = clCreateKernel(m_program, "simulate_volume", &error);
+      opencl_error_check(error);
+      setArguments(m_volume[i], a_current, b_current, a_buffer, b_buffer);
+      clSetKernelArg(m_volume[i], 8, sizeof(cl_int), &depth);
+      clSetKernelArg(m_volume[i], 9, sizeof(cl_int), &slab);
+    }
+
+    m_active[i] = NULL;
+    if(m_mask != NULL)
+    {
+      m_active[i] = clCreateKernel(m_program, "simulate_active", &error);
+      opencl_error_check(error);
+      setArguments(m_active[i], a_current, b_current, a_buffer, b_buffer);
+      clSetKernelArg(m_active[i], 8, sizeof(cl_mem), &m_tile_list);
+    }
+
+    m_stage[i] = NULL;
+    if(m_sum != NULL)
+    {
+      const cl_int width = m_grid.width;
+      const cl_int height = m_grid.height;
+      const cl_int stride = m_grid.stride;
+
+      m_stage[i] = clCreateKernel(m_program, "simulate_stage", &error);
+      opencl_error_check(error);
+      clSetKernelArg(m_stage[i], 0, sizeof(cl_mem), &a_current);
+      clSetKernelArg(m_stage[i], 1, sizeof(cl_mem), &b_current);
+      clSetKernelArg(m_stage[i], 2, sizeof(cl_mem), &a_buffer);
+      clSetKernelArg(m_stage[i], 3, sizeof(cl_mem), &b_buffer);
+      clSetKernelArg(m_stage[i], 4, sizeof(cl_mem), &m_parameters);
+      clSetKernelArg(m_stage[i], 5, sizeof(cl_int), &width);
+      clSetKernelArg(m_stage[i], 6, sizeof(cl_int), &height);
+      clSetKernelArg(m_stage[i], 7, sizeof(cl_int), &stride);
+      clSetKernelArg(m_stage[i], 10, sizeof(cl_mem), &m_sum);
+    }
+
+    m_colormap[i] = NULL;
+    if(m_image != NULL)
+    {
+      // Reads the buffers holding the latest state when i is the source
+      cl_mem latest = i ? m_buffer_a : m_current_a;
+      const float width = m_grid.width;
+      const float height = m_grid.height;
+      const cl_int stride = m_grid.stride;
+      const cl_int factor = m_downsample;
+
+      m_colormap[i] = clCreateKernel(m_program, m_use_volume ? "colormap_slice" : "colormap", &error);
+      opencl_error_check(error);
+      clSetKernelArg(m_colormap[i], 0, sizeof(cl_mem), &latest);
+      clSetKernelArg(m_colormap[i], 1, sizeof(float), &width);
+      clSetKernelArg(m_colormap[i], 2, sizeof(float), &height);
+      clSetKernelArg(m_colormap[i], 3, sizeof(cl_int), &stride);
+      clSetKernelArg(m_colormap[i], 4, sizeof(cl_int), &factor);
+      clSetKernelArg(m_colormap[i], 5, sizeof(cl_mem), &m_image);
+      if(m_use_volume)
+        clSetKernelArg(m_colormap[i], 6, sizeof(cl_int), &m_slice);
+    }
+  }
+
+  setMapArguments();
+
+  // The change is measured the same way whichever buffer holds the latest state
+  m_change_max = NULL;
+  if(m_change != NULL)
+  {
+    const cl_int width = m_grid.width;
+    const cl_int height = m_grid.height;
+    const cl_int stride = m_grid.stride;
+
+    m_change_max = clCreateKernel(m_program, "change_max", &error);
+    opencl_error_check(error);
+    clSetKernelArg(m_change_max, 0, sizeof(cl_mem), &m_current_a);
+    clSetKernelArg(m_change_max, 1, sizeof(cl_mem), &m_current_b);
+    clSetKernelArg(m_change_max, 2, sizeof(cl_mem), &m_buffer_a);
+    clSetKernelArg(m_change_max, 3, sizeof(cl_mem), &m_buffer_b);
+    clSetKernelArg(m_change_max, 4, sizeof(cl_int), &width);
+    clSetKernelArg(m_change_max, 5, sizeof(cl_int), &height);
+    clSetKernelArg(m_change_max, 6, sizeof(cl_int), &stride);
+    clSetKernelArg(m_change_max, 7, sizeof(cl_mem), &m_change);
+  }
+
+  // Activity is measured between the field buffers like the change, the tile
+  // sizes are set with the work-group size
+  m_tile_activity = NULL;
+  m_compact_tiles = NULL;
+  m_copy_settled = NULL;
+  if(m_mask != NULL)
+  {
+    const cl_int width = m_grid.width;
+    const cl_int height = m_grid.height;
+    const cl_int stride = m_grid.stride;
+
+    m_tile_activity = clCreateKernel(m_program, "tile_activity", &error);
+    opencl_error_check(error);
+    clSetKernelArg(m_tile_activity, 0, sizeof(cl_mem), &m_current_a);
+    clSetKernelArg(m_tile_activity, 1, sizeof(cl_mem), &m_current_b);
+    clSetKernelArg(m_tile_activity, 2, sizeof(cl_mem), &m_buffer_a);
+    clSetKernelArg(m_tile_activity, 3, sizeof(cl_mem), &m_buffer_b);
+    clSetKernelArg(m_tile_activity, 4, sizeof(cl_int), &width);
+    clSetKernelArg(m_tile_activity, 5, sizeof(cl_int), &height);
+    clSetKernelArg(m_tile_activity, 6, sizeof(cl_int), &stride);
+    clSetKernelArg(m_tile_activity, 7, sizeof(float), &m_active_threshold);
+    clSetKernelArg(m_tile_activity, 8, sizeof(cl_mem), &m_mask);
+
+    m_compact_tiles = clCreateKernel(m_program, "compact_tiles", &error);
+    opencl_error_check(error);
+    clSetKernelArg(m_compact_tiles, 0, sizeof(cl_mem), &m_mask);
+    clSetKernelArg(m_compact_tiles, 1, sizeof(cl_int), &width);
+    clSetKernelArg(m_compact_tiles, 2, sizeof(cl_int), &height);
+    clSetKernelArg(m_compact_tiles, 6, sizeof(cl_mem), &m_tile_list);
+    clSetKernelArg(m_compact_tiles, 7, sizeof(cl_mem), &m_tile_count);
+    clSetKernelArg(m_compact_tiles, 8, sizeof(cl_mem), &m_listed);
+
+    m_copy_settled = clCreateKernel(m_program, "copy_settled", &error);
+    opencl_error_check(error);
+    clSetKernelArg(m_copy_settled, 4, sizeof(cl_int), &width);
+    clSetKernelArg(m_copy_settled, 5, sizeof(cl_int), &height);
+    clSetKernelArg(m_copy_settled, 6, sizeof(cl_int), &stride);
+    clSetKernelArg(m_copy_settled, 7, sizeof(cl_mem), &m_listed);
+  }
+}
+
+void ClSolver::releaseKernels()
+{
+  if(m_compact_tiles != NULL)
+  {
+    clReleaseKernel(m_copy_settled);
+    clReleaseKernel(m_compact_tiles);
+    clReleaseKernel(m_tile_activity);
+  }
+  if(m_change_max != NULL)
+    clReleaseKernel(m_change_max);
+
+  for(int i = 0; i < 2; ++i)
+  {
+    if(m_active[i] != NULL)
+      clReleaseKernel(m_active[i]);
+    if(m_volume[i] != NULL)
+      clReleaseKernel(m_volume[i]);
+    if(m_stage[i] != NULL)
+      clReleaseKernel(m_stage[i]);
+    if(m_colormap[i] != NULL)
+      clReleaseKernel(m_colormap[i]);
+    clReleaseKernel(m_blocked[i]);
+    clReleaseKernel(m_tiled[i]);
+    clReleaseKernel(m_simulate[i]);
+  }
+}
+
+void ClSolver::setupLocal(const Options &_options)
+{
+  m_local[0] = _options.local_x;
+  m_local[1] = _options.local_y;
+  m_global[0] = ((m_grid.width + m_local[0] - 1) / m_local[0]) * m_local[0];
+  m_global[1] = ((m_grid.height + m_local[1] - 1) / m_local[1]) * m_local[1];
+  // Each work-group of the volume kernel steps one tile of one slab
+  m_volume_local[0] = m_local[0];
+  m_volume_local[1] = m_local[1];
+  m_volume_local[2] = 1;
+  m_volume_global[0] = m_global[0];
+  m_volume_global[1] = m_global[1];
+  m_volume_global[2] = (m_grid.depth + VOLUME_SLAB - 1) / VOLUME_SLAB;
+
+  std::size_t max_group = 0;
+  cl_ulong local_memory = 0;
+  clGetDeviceInfo(m_device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(local_memory), &local_memory, NULL);
+
+  // The change measurement reduces over work-groups of the same size whatever
+  // the kernel, with one float of local memory per work-item
+  if(m_change_max != NULL)
+  {
+    const std::size_t change_bytes = sizeof(float) * m_local[0] * m_local[1];
+    clGetKernelWorkGroupInfo(m_change_max, m_device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_group), &max_group, NULL);
+    if(m_local[0] * m_local[1] > max_group || change_bytes > local_memory)
+    {
+      std::cout << "Work-group " << m_local[0] << "x" << m_local[1] << " of the change measurement needs " << change_bytes << " bytes of local memory and does not fit the device, maximum size is " << max_group << " with " << local_memory << " bytes of local memory." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if(!m_use_tiled && m_block <= 1 && !m_use_volume)
+  {
+    setLocalArguments();
+    return;
+  }
+
+  // Check the work-group fits the device before any launch
+  cl_kernel kernel = m_block > 1 ? m_blocked[0] : m_tiled[0];
+  if(m_use_volume)
+    kernel = m_volume[0];
+  clGetKernelWorkGroupInfo(kernel, m_device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_group), &max_group, NULL);
+
+  // The volume kernel keeps three planes of a and of b with a one cell halo
+  if(m_use_volume)
+  {
+    const std::size_t planes_bytes = 6 * sizeof(float) * (m_local[0] + 2) * (m_local[1] + 2);
+    if(m_local[0] * m_local[1] > max_group || planes_bytes > local_memory)
+    {
+      std::cout << "Work-group " << m_local[0] << "x" << m_local[1] << " of the volume kernel needs " << planes_bytes << " bytes of local memory for its planes and does not fit the device, maximum size is " << max_group << " with " << local_memory << " bytes of local memory." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // The blocked kernel double buffers a tile with a halo as wide as the block
+  const std::size_t halo = m_block > 1 ? m_block : 1;
+  const std::size_t tile_bytes = sizeof(float) * (m_local[0] + 2 * halo) * (m_local[1] + 2 * halo);
+  const std::size_t tiles = m_block > 1 ? 4 : 2;
+  if(!m_use_volume && (m_local[0] * m_local[1] > max_group || tiles * tile_bytes > local_memory))
+  {
+    std::cout << "Work-group " << m_local[0] << "x" << m_local[1] << " with halo " << halo << " does not fit the device, maximum size is " << max_group << " with " << local_memory << " bytes of local memory." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  m_active_interval = std::min(m_local[0], m_local[1]);
+  setLocalArguments();
+  if(m_active_tiles)
+    activateAll();
+}
+
+void ClSolver::setLocalArguments()
+{
+  if(m_change_max != NULL)
+    clSetKernelArg(m_change_max, 8, sizeof(float) * m_local[0] * m_local[1], NULL);
+
+  if(!m_use_tiled && m_block <= 1 && !m_use_volume)
+    return;
+
+  const std::size_t halo = m_block > 1 ? m_block : 1;
+  const std::size_t tile_bytes = sizeof(float) * (m_local[0] + 2 * halo) * (m_local[1] + 2 * halo);
+  const std::size_t single_bytes = sizeof(float) * (m_local[0] + 2) * (m_local[1] + 2);
+  const cl_int steps = m_block;
+  for(int i = 0; i < 2; ++i)
+  {
+    clSetKernelArg(m_tiled[i], 8, single_bytes, NULL);
+    clSetKernelArg(m_tiled[i], 9, single_bytes, NULL);
+
+    clSetKernelArg(m_blocked[i], 8, sizeof(cl_int), &steps);
+    for(int j = 0; j < 4; ++j)
+      clSetKernelArg(m_blocked[i], 9 + j, tile_bytes, NULL);
+
+    // Three planes of a and of b roll through the volume kernel's tiles
+    if(m_volume[i] != NULL)
+    {
+      clSetKernelArg(m_volume[i], 10, 3 * single_bytes, NULL);
+      clSetKernelArg(m_volume[i], 11, 3 * single_bytes, NULL);
+    }
+  }
+
+  if(m_mask == NULL)
+    return;
+
+  // Tiles settle for good only once nothing within a tile's extent of them
+  // changed, so the list holds for that many steps
+  const cl_int tile_width = m_local[0];
+  const cl_int tile_height = m_local[1];
+  const cl_int columns = m_global[0] / m_local[0];
+  const cl_int reach = m_active_interval;
+  for(int i = 0; i < 2; ++i)
+  {
+    clSetKernelArg(m_active[i], 9, sizeof(cl_int), &columns);
+    clSetKernelArg(m_active[i], 10, single_bytes, NULL);
+    clSetKernelArg(m_active[i], 11, single_bytes, NULL);
+  }
+  clSetKernelArg(m_tile_activity, 9, sizeof(float) * m_local[0] * m_local[1], NULL);
+  clSetKernelArg(m_compact_tiles, 3, sizeof(cl_int), &tile_width);
+  clSetKernelArg(m_compact_tiles, 4, sizeof(cl_int), &tile_height);
+  clSetKernelArg(m_compact_tiles, 5, sizeof(cl_int), &reach);
+}
\ No newline at end of file
@@ -0,0 +1,606 @@
+#include <CpuSolver.h>
+#include <Utility.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  #define CPU_SOLVER_X86
+  #include <immintrin.h>
+#endif
+
+// Stencil weights matching laplacian() in kernels/image.cl
+#define WEIGHT_EDGE 0.2f
+#define WEIGHT_CORNER 0.05f
+#define WEIGHT_CENTRE -1.f
+
+// Update a single cell. Rows are ordered positive y, y, negative y and every
+// sum is evaluated in the same order as the OpenCL kernel.
+static inline void update_cell(float *_a_out, float *_b_out, const float *_a_rows[3], const float *_b_rows[3], const int _xm, const int _x, const int _xp, const InputData &_input)
+{
+  const float *ap = _a_rows[0], *ac = _a_rows[1], *an = _a_rows[2];
+  const float *bp = _b_rows[0], *bc = _b_rows[1], *bn = _b_rows[2];
+
+  float lap_a = ap[_xm] * WEIGHT_CORNER + ap[_x] * WEIGHT_EDGE + ap[_xp] * WEIGHT_CORNER
+  + ac[_xm] * WEIGHT_EDGE + ac[_x] * WEIGHT_CENTRE + ac[_xp] * WEIGHT_EDGE
+  + an[_xm] * WEIGHT_CORNER + an[_x] * WEIGHT_EDGE + an[_xp] * WEIGHT_CORNER;
+
+  float lap_b = bp[_xm] * WEIGHT_CORNER + bp[_x] * WEIGHT_EDGE + bp[_xp] * WEIGHT_CORNER
+  + bc[_xm] * WEIGHT_EDGE + bc[_x] * WEIGHT_CENTRE + bc[_xp] * WEIGHT_EDGE
+  + bn[_xm] * WEIGHT_CORNER + bn[_x] * WEIGHT_EDGE + bn[_xp] * WEIGHT_CORNER;
+
+  float a = ac[_x];
+  float b = bc[_x];
+  float reaction = a * (b * b);
+
+  _a_out[_x] = a + (_input.Da * lap_a - reaction + _input.f * (1.f - a)) * _input.delta;
+  _b_out[_x] = b + (_input.Db * lap_b + reaction - (_input.k + _input.f) * b) * _input.delta;
+}
+
+// Update the wrapping first and last cells of a row
+static inline void update_edges(float *_a_out, float *_b_out, const float *_a_rows[3], const float *_b_rows[3], const int _width, const InputData &_input)
+{
+  update_cell(_a_out, _b_out, _a_rows, _b_rows, _width - 1, 0, 1 % _width, _input);
+  if(_width > 1)
+    update_cell(_a_out, _b_out, _a_rows, _b_rows, _width - 2, _width - 1, 0, _input);
+}
+
+static void row_scalar(float *_a_out, float *_b_out, const float *_a_rows[3], const float *_b_rows[3], const int _width, const InputData &_input)
+{
+  update_edges(_a_out, _b_out, _a_rows, _b_rows, _width, _input);
+  for(int x = 1; x < _width - 1; ++x)
+    update_cell(_a_out, _b_out, _a_rows, _b_rows, x - 1, x, x + 1, _input);
+}
+
+// Interleaved rows hold a and b of each cell side by side. The a fields are
+// read at even offsets and the b fields at odd ones, with the same arithmetic.
+static inline void update_cell_interleaved(float *_out, const float *_rows[3], const int _xm, const int _x, const int _xp, const InputData &_input)
+{
+  const float *a_rows[3] = {_rows[0], _rows[1], _rows[2]};
+  const float *b_rows[3] = {_rows[0] + 1, _rows[1] + 1, _rows[2] + 1};
+  update_cell(_out, _out + 1, a_rows, b_rows, 2 * _xm, 2 * _x, 2 * _xp, _input);
+}
+
+static inline void update_edges_interleaved(float *_out, const float *_rows[3], const int _width, const InputData &_input)
+{
+  update_cell_interleaved(_out, _rows, _width - 1, 0, 1 % _width, _input);
+  if(_width > 1)
+    update_cell_interleaved(_out, _rows, _width - 2, _width - 1, 0, _input);
+}
+
+static void row_scalar_interleaved(float *_out, const float *_rows[3], const int _width, const InputData &_input)
+{
+  update_edges_interleaved(_out, _rows, _width, _input);
+  for(int x = 1; x < _width - 1; ++x)
+    update_cell_interleaved(_out, _rows, x - 1, x, x + 1, _input);
+}
+
+#ifdef CPU_SOLVER_X86
+
+__attribute__((target("avx2")))
+static inline __m256 laplacian_avx2(const float *_rows[3], const int _x)
+{
+  const __m256 edge = _mm256_set1_ps(WEIGHT_EDGE);
+  const __m256 corner = _mm256_set1_ps(WEIGHT_CORNER);
+  const __m256 centre = _mm256_set1_ps(WEIGHT_CENTRE);
+
+  __m256 sum = _mm256_mul_ps(_mm256_loadu_ps(_rows[0] + _x - 1), corner);
+  sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(_rows[0] + _x), edge));
+  sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(_rows[0] + _x + 1), corner));
+  sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(_rows[1] + _x - 1), edge));
+  sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(_rows[1] + _x), centre));
+  sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(_rows[1] + _x + 1), edge));
+  sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(_rows[2] + _x - 1), corner));
+  sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(_rows[2] + _x), edge));
+  sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(_rows[2] + _x + 1), corner));
+  return sum;
+}
+
+__attribute__((target("avx2")))
+static void row_avx2(float *_a_out, float *_b_out, const float *_a_rows[3], const float *_b_rows[3], const int _width, const InputData &_input)
+{
+  const __m256 Da = _mm256_set1_ps(_input.Da);
+  const __m256 Db = _mm256_set1_ps(_input.Db);
+  const __m256 f = _mm256_set1_ps(_input.f);
+  const __m256 kf = _mm256_set1_ps(_input.k + _input.f);
+  const __m256 delta = _mm256_set1_ps(_input.delta);
+  const __m256 one = _mm256_set1_ps(1.f);
+
+  update_edges(_a_out, _b_out, _a_rows, _b_rows, _width, _input);
+
+  int x = 1;
+  for(; x + 8 <= _width - 1; x += 8)
+  {
+    __m256 a = _mm256_loadu_ps(_a_rows[1] + x);
+    __m256 b = _mm256_loadu_ps(_b_rows[1] + x);
+    __m256 reaction = _mm256_mul_ps(a, _mm256_mul_ps(b, b));
+
+    __m256 da = _mm256_sub_ps(_mm256_mul_ps(Da, laplacian_avx2(_a_rows, x)), reaction);
+    da = _mm256_add_ps(da, _mm256_mul_ps(f, _mm256_sub_ps(one, a)));
+    __m256 db = _mm256_add_ps(_mm256_mul_ps(Db, laplacian_avx2(_b_rows, x)), reaction);
+    db = _mm256_sub_ps(db, _mm256_mul_ps(kf, b));
+
+    _mm256_storeu_ps(_a_out + x, _mm256_add_ps(a, _mm256_mul_ps(da, delta)));
+    _mm256_storeu_ps(_b_out + x, _mm256_add_ps(b, _mm256_mul_ps(db, delta)));
+  }
+
+  for(; x < _width - 1; ++x)
+    update_cell(_a_out, _b_out, _a_rows, _b_rows, x - 1, x, x + 1, _input);
+}
+
+// The laplacian is the same linear stencil for a and b, so on interleaved rows
+// it is evaluated on a/b pairs directly with neighbours two floats apart. The
+// reaction then needs a and b of each cell in both lanes of its pair.
+__attribute__((target("avx2")))
+static void row_avx2_interleaved(float *_out, const float *_rows[3], const int _width, const InputData &_input)
+{
+  const __m256 edge = _mm256_set1_ps(WEIGHT_EDGE);
+  const __m256 corner = _mm256_set1_ps(WEIGHT_CORNER);
+  const __m256 centre = _mm256_set1_ps(WEIGHT_CENTRE);
+  const __m256 D = _mm256_setr_ps(_input.Da, _input.Db, _input.Da, _input.Db, _input.Da, _input.Db, _input.Da, _input.Db);
+  const __m256 f = _mm256_set1_ps(_input.f);
+  const __m256 kf = _mm256_set1_ps(_input.k + _input.f);
+  const __m256 delta = _mm256_set1_ps(_input.delta);
+  const __m256 one = _mm256_set1_ps(1.f);
+
+  update_edges_interleaved(_out, _rows, _width, _input);
+
+  int x = 1;
+  for(; x + 4 <= _width - 1; x += 4)
+  {
+    const int i = 2 * x;
+    __m256 lap = _mm256_mul_ps(_mm256_loadu_ps(_rows[0] + i - 2), corner);
+    lap = _mm256_add_ps(lap, _mm256_mul_ps(_mm256_loadu_ps(_rows[0] + i), edge));
+    lap = _mm256_add_ps(lap, _mm256_mul_ps(_mm256_loadu_ps(_rows[0] + i + 2), corner));
+    lap = _mm256_add_ps(lap, _mm256_mul_ps(_mm256_loadu_ps(_rows[1] + i - 2), edge));
+    lap = _mm256_add_ps(lap, _mm256_mul_ps(_mm256_loadu_ps(_rows[1] + i), centre));
+    lap = _mm256_add_ps(lap, _mm256_mul_ps(_mm256_loadu_ps(_rows[1] + i + 2), edge));
+    lap = _mm256_add_ps(lap, _mm256_mul_ps(_mm256_loadu_ps(_rows[2] + i - 2), corner));
+    lap = _mm256_add_ps(lap, _mm256_mul_ps(_mm256_loadu_ps(_rows[2] + i), edge));
+    lap = _mm256_add_ps(lap, _mm256_mul_ps(_mm256_loadu_ps(_rows[2] + i + 2), corner));
+
+    __m256 cell = _mm256_loadu_ps(_rows[1] + i);
+    __m256 a = _mm256_moveldup_ps(cell);
+    __m256 b = _mm256_movehdup_ps(cell);
+    __m256 reaction = _mm256_mul_ps(a, _mm256_mul_ps(b, b));
+
+    // a lanes subtract the reaction and add the feed, b lanes the opposite with the kill
+    __m256 diffusion = _mm256_mul_ps(D, lap);
+    __m256 da = _mm256_add_ps(_mm256_sub_ps(diffusion, reaction), _mm256_mul_ps(f, _mm256_sub_ps(one, a)));
+    __m256 db = _mm256_sub_ps(_mm256_add_ps(diffusion, reaction), _mm256_mul_ps(kf, b));
+    __m256 change = _mm256_blend_ps(da, db, 0xAA);
+
+    _mm256_storeu_ps(_out + i, _mm256_add_ps(cell, _mm256_mul_ps(change, delta)));
+  }
+
+  for(; x < _width - 1; ++x)
+    update_cell_interleaved(_out, _rows, x - 1, x, x + 1, _input);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 laplacian_avx512(const float *_rows[3], const int _x)
+{
+  const __m512 edge = _mm512_set1_ps(WEIGHT_EDGE);
+  const __m512 corner = _mm512_set1_ps(WEIGHT_CORNER);
+  const __m512 centre = _mm512_set1_ps(WEIGHT_CENTRE);
+
+  __m512 sum = _mm512_mul_ps(_mm512_loadu_ps(_rows[0] + _x - 1), corner);
+  sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_loadu_ps(_rows[0] + _x), edge));
+  sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_loadu_ps(_rows[0] + _x + 1), corner));
+  sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_loadu_ps(_rows[1] + _x - 1), edge));
+  sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_loadu_ps(_rows[1] + _x), centre));
+  sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_loadu_ps(_rows[1] + _x + 1), edge));
+  sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_loadu_ps(_rows[2] + _x - 1), corner));
+  sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_loadu_ps(_rows[2] + _x), edge));
+  sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_loadu_ps(_rows[2] + _x + 1), corner));
+  return sum;
+}
+
+__attribute__((target("avx512f")))
+static void row_avx512(float *_a_out, float *_b_out, const float *_a_rows[3], const float *_b_rows[3], const int _width, const InputData &_input)
+{
+  const __m512 Da = _mm512_set1_ps(_input.Da);
+  const __m512 Db = _mm512_set1_ps(_input.Db);
+  const __m512 f = _mm512_set1_ps(_input.f);
+  const __m512 kf = _mm512_set1_ps(_input.k + _input.f);
+  const __m512 delta = _mm512_set1_ps(_input.delta);
+  const __m512 one = _mm512_set1_ps(1.f);
+
+  update_edges(_a_out, _b_out, _a_rows, _b_rows, _width, _input);
+
+  int x = 1;
+  for(; x + 16 <= _width - 1; x += 16)
+  {
+    __m512 a = _mm512_loadu_ps(_a_rows[1] + x);
+    __m512 b = _mm512_loadu_ps(_b_rows[1] + x);
+    __m512 reaction = _mm512_mul_ps(a, _mm512_mul_ps(b, b));
+
+    __m512 da = _mm512_sub_ps(_mm512_mul_ps(Da, laplacian_avx512(_a_rows, x)), reaction);
+    da = _mm512_add_ps(da, _mm512_mul_ps(f, _mm512_sub_ps(one, a)));
+    __m512 db = _mm512_add_ps(_mm512_mul_ps(Db, laplacian_avx512(_b_rows, x)), reaction);
+    db = _mm512_sub_ps(db, _mm512_mul_ps(kf, b));
+
+    _mm512_storeu_ps(_a_out + x, _mm512_add_ps(a, _mm512_mul_ps(da, delta)));
+    _mm512_storeu_ps(_b_out + x, _mm512_add_ps(b, _mm512_mul_ps(db, delta)));
+  }
+
+  for(; x < _width - 1; ++x)
+    update_cell(_a_out, _b_out, _a_rows, _b_rows, x - 1, x, x + 1, _input);
+}
+
+__attribute__((target("avx512f")))
+static void row_avx512_interleaved(float *_out, const float *_rows[3], const int _width, const InputData &_input)
+{
+  const __m512 edge = _mm512_set1_ps(WEIGHT_EDGE);
+  const __m512 corner = _mm512_set1_ps(WEIGHT_CORNER);
+  const __m512 centre = _mm512_set1_ps(WEIGHT_CENTRE);
+  const __m512 D = _mm512_setr_ps(_input.Da, _input.Db, _input.Da, _input.Db, _input.Da, _input.Db, _input.Da, _input.Db,
+                                  _input.Da, _input.Db, _input.Da, _input.Db, _input.Da, _input.Db, _input.Da, _input.Db);
+  const __m512 f = _mm512_set1_ps(_input.f);
+  const __m512 kf = _mm512_set1_ps(_input.k + _input.f);
+  const __m512 delta = _mm512_set1_ps(_input.delta);
+  const __m512 one = _mm512_set1_ps(1.f);
+
+  update_edges_interleaved(_out, _rows, _width, _input);
+
+  int x = 1;
+  for(; x + 8 <= _width - 1; x += 8)
+  {
+    const int i = 2 * x;
+    __m512 lap = _mm512_mul_ps(_mm512_loadu_ps(_rows[0] + i - 2), corner);
+    lap = _mm512_add_ps(lap, _mm512_mul_ps(_mm512_loadu_ps(_rows[0] + i), edge));
+    lap = _mm512_add_ps(lap, _mm512_mul_ps(_mm512_loadu_ps(_rows[0] + i + 2), corner));
+    lap = _mm512_add_ps(lap, _mm512_mul_ps(_mm512_loadu_ps(_rows[1] + i - 2), edge));
+    lap = _mm512_add_ps(lap, _mm512_mul_ps(_mm512_loadu_ps(_rows[1] + i), centre));
+    lap = _mm512_add_ps(lap, _mm512_mul_ps(_mm512_loadu_ps(_rows[1] + i + 2), edge));
+    lap = _mm512_add_ps(lap, _mm512_mul_ps(_mm512_loadu_ps(_rows[2] + i - 2), corner));
+    lap = _mm512_add_ps(lap, _mm512_mul_ps(_mm512_loadu_ps(_rows[2] + i), edge));
+    lap = _mm512_add_ps(lap, _mm512_mul_ps(_mm512_loadu_ps(_rows[2] + i + 2), corner));
+
+    __m512 cell = _mm512_loadu_ps(_rows[1] + i);
+    __m512 a = _mm512_moveldup_ps(cell);
+    __m512 b = _mm512_movehdup_ps(cell);
+    __m512 reaction = _mm512_mul_ps(a, _mm512_mul_ps(b, b));
+
+    __m512 diffusion = _mm512_mul_ps(D, lap);
+    __m512 da = _mm512_add_ps(_mm512_sub_ps(diffusion, reaction), _mm512_mul_ps(f, _mm512_sub_ps(one, a)));
+    __m512 db = _mm512_sub_ps(_mm512_add_ps(diffusion, reaction), _mm512_mul_ps(kf, b));
+    __m512 change = _mm512_mask_blend_ps(0xAAAA, da, db);
+
+    _mm512_storeu_ps(_out + i, _mm512_add_ps(cell, _mm512_mul_ps(change, delta)));
+  }
+
+  for(; x < _width - 1; ++x)
+    update_cell_interleaved(_out, _rows, x - 1, x, x + 1, _input);
+}
+
+#endif
+
+CpuSolver::CpuSolver(const Grid &_grid, const InputData &_input, const float *_a, const float *_b, const unsigned int _threads, const Storage _storage, const Layout _layout, Framebuffer *_framebuffer, const unsigned int _downsample)
+  : m_grid(_grid)
+  , m_iteration(0)
+  , m_input(_input)
+  , m_framebuffer(_framebuffer)
+  , m_downsample(std::max(1u, _downsample))
+  , m_storage(_storage)
+  , m_layout(_layout)
+  , m_kernel(row_scalar)
+  , m_interleaved_kernel(row_scalar_interleaved)
+  , m_kernel_name("scalar")
+  , m_pending(0)
+  , m_exit(false)
+{
+  // Interleaved fields hold both a and b in the a buffers
+  const std::size_t bytes = storage_bytes(m_storage) * m_grid.size();
+  for(int i = 0; i < 2; ++i)
+  {
+    if(m_layout == LAYOUT_INTERLEAVED)
+    {
+      m_a[i] = allocate_aligned(2 * bytes);
+      m_b[i] = NULL;
+      memset(m_a[i], 0, 2 * bytes);
+    }
+    else
+    {
+      m_a[i] = allocate_aligned(bytes);
+      m_b[i] = allocate_aligned(bytes);
+      memset(m_a[i], 0, bytes);
+      memset(m_b[i], 0, bytes);
+    }
+  }
+
+  if(m_layout == LAYOUT_INTERLEAVED)
+  {
+    pack_fields(m_storage, m_layout, _a, _b, m_a[0], m_grid.size());
+  }
+  else
+  {
+    pack_values(m_storage, _a, m_a[0], m_grid.size());
+    pack_values(m_storage, _b, m_b[0], m_grid.size());
+  }
+
+  // Pick the widest row kernel available on this processor
+  if(!selectKernel("avx512"))
+    selectKernel("avx2");
+
+  m_thread_count = _threads ? _threads : boost::thread::hardware_concurrency();
+  m_thread_count = std::max(1u, std::min(m_thread_count, static_cast<unsigned int>(m_grid.height)));
+
+  m_start = new boost::barrier(m_thread_count + 1);
+  m_end = new boost::barrier(m_thread_count + 1);
+  m_sync = new boost::barrier(m_thread_count);
+
+  for(unsigned int i = 0; i < m_thread_count; ++i)
+    m_threads.create_thread([this, i]() { worker(i); });
+}
+
+CpuSolver::~CpuSolver()
+{
+  m_exit = true;
+  m_start->wait();
+  m_threads.join_all();
+
+  delete m_sync;
+  delete m_end;
+  delete m_start;
+
+  for(int i = 0; i < 2; ++i)
+  {
+    free_aligned(m_b[i]);
+    free_aligned(m_a[i]);
+  }
+}
+
+void CpuSolver::step(const unsigned int _count)
+{
+  if(_count == 0)
+    return;
+
+  // Workers run every step between the two barriers, syncing on each step
+  m_pending = _count;
+  m_start->wait();
+  m_end->wait();
+  m_iteration += _count;
+}
+
+void CpuSolver::present()
+{
+  if(m_framebuffer == NULL)
+    return;
+
+  // Grey scale image of a averaged over blocks of cells, as written by the OpenCL colormap kernel
+  const float *a = static_cast<const float*>(m_a[m_iteration % 2]);
+  if(m_storage != STORAGE_FP32 || m_layout != LAYOUT_PLANAR)
+  {
+    m_unpacked.resize(2 * m_grid.size());
+    read(&m_unpacked[0], &m_unpacked[m_grid.size()]);
+    a = &m_unpacked[0];
+  }
+
+  const int width = (m_grid.width + m_downsample - 1) / m_downsample;
+  const int height = (m_grid.height + m_downsample - 1) / m_downsample;
+  m_image.resize(static_cast<std::size_t>(width) * height * 3);
+  for(int y = 0; y < height; ++y)
+  {
+    const int y_end = std::min((y + 1) * m_downsample, m_grid.height);
+    for(int x = 0; x < width; ++x)
+    {
+      const int x_end = std::min((x + 1) * m_downsample, m_grid.width);
+      float sum = 0.f;
+      for(int j = y * m_downsample; j < y_end; ++j)
+      {
+        for(int i = x * m_downsample; i < x_end; ++i)
+        {
+          sum += a[static_cast<std::size_t>(j) * m_grid.stride + i];
+        }
+      }
+
+      const float value = sum / ((x_end - x * m_downsample) * (y_end - y * m_downsample));
+      const std::size_t pixel = (static_cast<std::size_t>(y) * width + x) * 3;
+      m_image[pixel + 0] = value;
+      m_image[pixel + 1] = value;
+      m_image[pixel + 2] = value;
+    }
+  }
+  m_framebuffer->image(&m_image[0], width, height);
+}
+
+void CpuSolver::read(float *_a, float *_b)
+{
+  const int latest = m_iteration % 2;
+  if(m_layout == LAYOUT_INTERLEAVED)
+  {
+    unpack_fields(m_storage, m_layout, m_a[latest], _a, _b, m_grid.size());
+  }
+  else
+  {
+    unpack_values(m_storage, m_a[latest], _a, m_grid.size());
+    unpack_values(m_storage, m_b[latest], _b, m_grid.size());
+  }
+}
+
+void CpuSolver::finish()
+{
+  // Steps complete before step() returns
+}
+
+unsigned int CpuSolver::iteration() const
+{
+  return m_iteration;
+}
+
+void CpuSolver::resume(const unsigned int _iteration)
+{
+  // The latest fields live in the buffer picked by the iteration's parity
+  if((_iteration % 2) != (m_iteration % 2))
+  {
+    std::swap(m_a[0], m_a[1]);
+    std::swap(m_b[0], m_b[1]);
+  }
+  m_iteration = _iteration;
+}
+
+void CpuSolver::parameters(const InputData &_input)
+{
+  // Workers only read the coefficients between the start and end barriers
+  m_input = _input;
+}
+
+const char* CpuSolver::kernel() const
+{
+  return m_kernel_name;
+}
+
+bool CpuSolver::selectKernel(const char *_name)
+{
+  if(!findKernel(_name, &m_kernel, &m_interleaved_kernel))
+    return false;
+
+  m_kernel_name = strcmp(_name, "avx512") == 0 ? "avx512" : strcmp(_name, "avx2") == 0 ? "avx2" : "scalar";
+  return true;
+}
+
+bool CpuSolver::findKernel(const char *_name, RowKernel *_kernel, InterleavedRowKernel *_interleaved_kernel)
+{
+  if(strcmp(_name, "scalar") == 0)
+  {
+    *_kernel = row_scalar;
+    *_interleaved_kernel = row_scalar_interleaved;
+    return true;
+  }
+
+  #ifdef CPU_SOLVER_X86
+    __builtin_cpu_init();
+    if(strcmp(_name, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+    {
+      *_kernel = row_avx2;
+      *_interleaved_kernel = row_avx2_interleaved;
+      return true;
+    }
+    if(strcmp(_name, "avx512") == 0 && __builtin_cpu_supports("avx512f"))
+    {
+      *_kernel = row_avx512;
+      *_interleaved_kernel = row_avx512_interleaved;
+      return true;
+    }
+  #endif
+
+  return false;
+}
+
+void CpuSolver::worker(const unsigned int _index)
+{
+  const int row_begin = static_cast<int>((static_cast<long long>(m_grid.height) * _index) / m_thread_count);
+  const int row_end = static_cast<int>((static_cast<long long>(m_grid.height) * (_index + 1)) / m_thread_count);
+
+  // Three unpacked rows of a and b plus an output row of each, whatever the layout
+  float *scratch = NULL;
+  if(m_storage != STORAGE_FP32)
+    scratch = static_cast<float*>(allocate_aligned(sizeof(float) * 8 * m_grid.stride));
+
+  while(true)
+  {
+    m_start->wait();
+    if(m_exit)
+      break;
+
+    for(unsigned int s = 0; s < m_pending; ++s)
+    {
+      const int source = (m_iteration + s) % 2;
+      if(m_storage == STORAGE_FP32)
+        stepRows(source, row_begin, row_end);
+      else
+        stepPackedRows(source, row_begin, row_end, scratch);
+
+      // Every row must be written before the next step reads it
+      m_sync->wait();
+    }
+
+    m_end->wait();
+  }
+
+  free_aligned(scratch);
+}
+
+void CpuSolver::stepRows(const int _source, const int _begin, const int _end)
+{
+  const bool interleaved = m_layout == LAYOUT_INTERLEAVED;
+  const std::size_t row_floats = (interleaved ? 2 : 1) * static_cast<std::size_t>(m_grid.stride);
+  const float *a_in = static_cast<const float*>(m_a[_source]);
+  const float *b_in = static_cast<const float*>(m_b[_source]);
+  float *a_out = static_cast<float*>(m_a[1 - _source]);
+  float *b_out = static_cast<float*>(m_b[1 - _source]);
+
+  for(int y = _begin; y < _end; ++y)
+  {
+    const std::size_t positive_y = static_cast<std::size_t>((y + 1) % m_grid.height) * row_floats;
+    const std::size_t current_y = static_cast<std::size_t>(y) * row_floats;
+    const std::size_t negative_y = static_cast<std::size_t>((y + m_grid.height - 1) % m_grid.height) * row_floats;
+
+    const float *a_rows[3] = {a_in + positive_y, a_in + current_y, a_in + negative_y};
+    if(interleaved)
+    {
+      m_interleaved_kernel(a_out + current_y, a_rows, m_grid.width, m_input);
+      continue;
+    }
+
+    const float *b_rows[3] = {b_in + positive_y, b_in + current_y, b_in + negative_y};
+    m_kernel(a_out + current_y, b_out + current_y, a_rows, b_rows, m_grid.width, m_input);
+  }
+}
+
+void CpuSolver::stepPackedRows(const int _source, const int _begin, const int _end, float *_scratch)
+{
+  // Interleaved rows are twice as long and hold both fields, so only the a window is used
+  const bool interleaved = m_layout == LAYOUT_INTERLEAVED;
+  const std::size_t row_values = (interleaved ? 2 : 1) * static_cast<std::size_t>(m_grid.stride);
+  const std::size_t row_bytes = storage_bytes(m_storage) * row_values;
+  const std::size_t width = (interleaved ? 2 : 1) * static_cast<std::size_t>(m_grid.width);
+  const char *a_in = static_cast<const char*>(m_a[_source]);
+  const char *b_in = static_cast<const char*>(m_b[_source]);
+  char *a_out = static_cast<char*>(m_a[1 - _source]);
+  char *b_out = static_cast<char*>(m_b[1 - _source]);
+
+  // Window of rows ordered negative y, y, positive y, each row is unpacked once per step
+  float *a_window[3], *b_window[3];
+  for(int i = 0; i < 3; ++i)
+  {
+    a_window[i] = _scratch + i * row_values;
+    b_window[i] = _scratch + (3 + i) * m_grid.stride;
+  }
+  float *a_row = _scratch + 6 * m_grid.stride;
+  float *b_row = _scratch + 7 * m_grid.stride;
+
+  const int negative_y = (_begin + m_grid.height - 1) % m_grid.height;
+  unpack_values(m_storage, a_in + negative_y * row_bytes, a_window[0], width);
+  unpack_values(m_storage, a_in + _begin * row_bytes, a_window[1], width);
+  if(!interleaved)
+  {
+    unpack_values(m_storage, b_in + negative_y * row_bytes, b_window[0], width);
+    unpack_values(m_storage, b_in + _begin * row_bytes, b_window[1], width);
+  }
+
+  for(int y = _begin; y < _end; ++y)
+  {
+    const std::size_t positive_y = static_cast<std::size_t>((y + 1) % m_grid.height);
+    unpack_values(m_storage, a_in + positive_y * row_bytes, a_window[2], width);
+
+    const float *a_rows[3] = {a_window[2], a_window[1], a_window[0]};
+    if(interleaved)
+    {
+      m_interleaved_kernel(a_row, a_rows, m_grid.width, m_input);
+      pack_values(m_storage, a_row, a_out + y * row_bytes, width);
+    }
+    else
+    {
+      unpack_values(m_storage, b_in + positive_y * row_bytes, b_window[2], width);
+      const float *b_rows[3] = {b_window[2], b_window[1], b_window[0]};
+      m_kernel(a_row, b_row, a_rows, b_rows, m_grid.width, m_input);
+      pack_values(m_storage, a_row, a_out + y * row_bytes, width);
+      pack_values(m_storage, b_row, b_out + y * row_bytes, width);
+    }
+
+    std::rotate(a_window, a_window + 1, a_window + 3);
+    std::rotate(b_window, b_window + 1, b_window + 3);
+  }
+}
@@ -0,0 +1,182 @@
+#include <DistributedSolver.h>
+#include <Utility.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+DistributedSolver::DistributedSolver(const Grid &_grid, const InputData &_input, const float *_a, const float *_b, Transport *_transport)
+  : m_grid(_grid)
+  , m_iteration(0)
+  , m_input(_input)
+  , m_transport(_transport)
+  , m_kernel(NULL)
+  , m_kernel_name("scalar")
+{
+  const int ranks = m_transport->size();
+  const int rank = m_transport->rank();
+  if(m_grid.height < ranks)
+  {
+    std::cout << "The grid has fewer rows than the " << ranks << " ranks." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  m_rows = m_grid.height / ranks + (rank < m_grid.height % ranks ? 1 : 0);
+  m_row = rank * (m_grid.height / ranks) + std::min(rank, m_grid.height % ranks);
+
+  // The initial halos are taken from the full fields, wrapping at the top and bottom
+  const std::size_t bytes = sizeof(float) * m_grid.stride * (m_rows + 2);
+  for(int i = 0; i < 2; ++i)
+  {
+    m_a[i] = static_cast<float*>(allocate_aligned(bytes));
+    m_b[i] = static_cast<float*>(allocate_aligned(bytes));
+    memset(m_a[i], 0, bytes);
+    memset(m_b[i], 0, bytes);
+  }
+  for(int r = 0; r < m_rows + 2; ++r)
+  {
+    const std::size_t source = static_cast<std::size_t>((m_row - 1 + r + m_grid.height) % m_grid.height) * m_grid.stride;
+    memcpy(m_a[0] + r * m_grid.stride, _a + source, sizeof(float) * m_grid.stride);
+    memcpy(m_b[0] + r * m_grid.stride, _b + source, sizeof(float) * m_grid.stride);
+  }
+
+  // Pick the widest row kernel available on this processor
+  CpuSolver::InterleavedRowKernel interleaved_kernel;
+  if(CpuSolver::findKernel("avx512", &m_kernel, &interleaved_kernel))
+    m_kernel_name = "avx512";
+  else if(CpuSolver::findKernel("avx2", &m_kernel, &interleaved_kernel))
+    m_kernel_name = "avx2";
+  else
+    CpuSolver::findKernel("scalar", &m_kernel, &interleaved_kernel);
+}
+
+DistributedSolver::~DistributedSolver()
+{
+  for(int i = 0; i < 2; ++i)
+  {
+    free_aligned(m_b[i]);
+    free_aligned(m_a[i]);
+  }
+}
+
+void DistributedSolver::step(const unsigned int _count)
+{
+  const std::size_t stride = m_grid.stride;
+  const std::size_t row_bytes = sizeof(float) * m_grid.width;
+  const std::size_t last = static_cast<std::size_t>(m_rows) * stride;
+  const std::size_t bottom = static_cast<std::size_t>(m_rows + 1) * stride;
+
+  for(unsigned int s = 0; s < _count; ++s)
+  {
+    const int source = m_iteration % 2;
+    float *a = m_a[1 - source];
+    float *b = m_b[1 - source];
+
+    // Halos of the new state arrive while the strip is computed
+    m_transport->irecv(LINK_UP, a, row_bytes);
+    m_transport->irecv(LINK_UP, b, row_bytes);
+    m_transport->irecv(LINK_DOWN, a + bottom, row_bytes);
+    m_transport->irecv(LINK_DOWN, b + bottom, row_bytes);
+
+    // Rows the neighbours need go first
+    stepRows(source, 1, 2);
+    if(m_rows > 1)
+      stepRows(source, m_rows, m_rows + 1);
+
+    m_transport->isend(LINK_UP, a + stride, row_bytes);
+    m_transport->isend(LINK_UP, b + stride, row_bytes);
+    m_transport->isend(LINK_DOWN, a + last, row_bytes);
+    m_transport->isend(LINK_DOWN, b + last, row_bytes);
+
+    for(int y = 2; y < m_rows; y += PROGRESS_ROWS)
+    {
+      stepRows(source, y, std::min(y + PROGRESS_ROWS, m_rows));
+      m_transport->progress();
+    }
+
+    m_transport->wait();
+    ++m_iteration;
+  }
+}
+
+void DistributedSolver::present()
+{
+  // Nothing is displayed from a rank
+}
+
+void DistributedSolver::read(float *_a, float *_b)
+{
+  const std::size_t offset = static_cast<std::size_t>(m_row) * m_grid.stride;
+  const std::size_t bytes = sizeof(float) * m_grid.stride * m_rows;
+  memcpy(_a + offset, a(), bytes);
+  memcpy(_b + offset, b(), bytes);
+}
+
+void DistributedSolver::finish()
+{
+  // Steps and their exchanges complete before step() returns
+}
+
+unsigned int DistributedSolver::iteration() const
+{
+  return m_iteration;
+}
+
+void DistributedSolver::resume(const unsigned int _iteration)
+{
+  // The latest fields live in the buffer picked by the iteration's parity
+  if((_iteration % 2) != (m_iteration % 2))
+  {
+    std::swap(m_a[0], m_a[1]);
+    std::swap(m_b[0], m_b[1]);
+  }
+  m_iteration = _iteration;
+}
+
+void DistributedSolver::parameters(const InputData &_input)
+{
+  m_input = _input;
+}
+
+int DistributedSolver::row() const
+{
+  return m_row;
+}
+
+int DistributedSolver::rows() const
+{
+  return m_rows;
+}
+
+const float* DistributedSolver::a() const
+{
+  return m_a[m_iteration % 2] + m_grid.stride;
+}
+
+const float* DistributedSolver::b() const
+{
+  return m_b[m_iteration % 2] + m_grid.stride;
+}
+
+const char* DistributedSolver::kernel() const
+{
+  return m_kernel_name;
+}
+
+void DistributedSolver::stepRows(const int _source, const int _begin, const int _end)
+{
+  const std::size_t stride = m_grid.stride;
+  const float *a_in = m_a[_source];
+  const float *b_in = m_b[_source];
+  float *a_out = m_a[1 - _source];
+  float *b_out = m_b[1 - _source];
+
+  // Strip rows are local, the halo rows stand in for the wrapped neighbours
+  for(int y = _begin; y < _end; ++y)
+  {
+    const float *a_rows[3] = {a_in + (y + 1) * stride, a_in + y * stride, a_in + (y - 1) * stride};
+    const float *b_rows[3] = {b_in + (y + 1) * stride, b_in + y * stride, b_in + (y - 1) * stride};
+    m_kernel(a_out + y * stride, b_out + y * stride, a_rows, b_rows, m_grid.width, m_input);
+  }
+}
@@ -0,0 +1,203 @@
+#include <FieldStream.h>
+#include <Utility.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+FieldStream::FieldStream(ClSolver *_solver, const std::string &_prefix, const unsigned int _slots)
+  : m_solver(_solver)
+  , m_grid(_solver->grid())
+  , m_storage(_solver->storage())
+  , m_layout(_solver->layout())
+  , m_prefix(_prefix)
+  , m_slots(_slots > 0 ? _slots : 1)
+  , m_next(0)
+  , m_exit(false)
+  , m_frames(0)
+  , m_stalls(0)
+{
+  const ClEnvironment *environment = m_solver->environment();
+  m_transfer = environment->createQueue();
+
+  // Error code
+  cl_int error = CL_SUCCESS;
+  const std::size_t bytes = storage_bytes(m_storage) * m_grid.size();
+
+  for(std::size_t i = 0; i < m_slots.size(); ++i)
+  {
+    Slot &slot = m_slots[i];
+    slot.device = clCreateBuffer(environment->context(), CL_MEM_READ_WRITE, 2 * bytes, NULL, &error);
+    opencl_error_check(error);
+
+    // Pinned staging memory holding both fields, mapped once for its lifetime
+    slot.pinned = clCreateBuffer(environment->context(), CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, 2 * bytes, NULL, &error);
+    opencl_error_check(error);
+    slot.host = static_cast<char*>(clEnqueueMapBuffer(m_transfer, slot.pinned, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, 2 * bytes, 0, NULL, NULL, &error));
+    opencl_error_check(error);
+
+    slot.read = NULL;
+    slot.iteration = 0;
+    slot.busy = false;
+    slot.checkpoint = false;
+  }
+
+  m_thread = boost::thread(&FieldStream::writer, this);
+}
+
+FieldStream::~FieldStream()
+{
+  flush();
+
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_exit = true;
+  }
+  m_queued.notify_all();
+  m_thread.join();
+
+  for(std::size_t i = 0; i < m_slots.size(); ++i)
+  {
+    Slot &slot = m_slots[i];
+    clEnqueueUnmapMemObject(m_transfer, slot.pinned, slot.host, 0, NULL, NULL);
+    clFinish(m_transfer);
+    clReleaseMemObject(slot.pinned);
+    clReleaseMemObject(slot.device);
+  }
+  clReleaseCommandQueue(m_transfer);
+}
+
+void FieldStream::push()
+{
+  queue(false, std::string(), CheckpointHeader());
+}
+
+void FieldStream::checkpoint(const std::string &_filepath, const InputData &_input, const unsigned int _seed)
+{
+  queue(true, _filepath, checkpoint_header(m_grid, _input, m_solver->iteration(), _seed));
+}
+
+void FieldStream::queue(const bool _checkpoint, const std::string &_filepath, const CheckpointHeader &_header)
+{
+  Slot &slot = m_slots[m_next];
+
+  // Only reuse a slot once its frame is on disk
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    if(slot.busy)
+    {
+      ++m_stalls;
+      while(slot.busy)
+        m_freed.wait(lock);
+    }
+    slot.busy = true;
+  }
+
+  // Device side copy on the compute queue, then readback on the transfer queue once it is done
+  cl_event copied = NULL;
+  m_solver->snapshot(slot.device, &copied);
+
+  const std::size_t bytes = storage_bytes(m_storage) * m_grid.size();
+  opencl_error_check(clEnqueueReadBuffer(m_transfer, slot.device, CL_FALSE, 0, 2 * bytes, slot.host, 1, &copied, &slot.read));
+  clFlush(m_transfer);
+  clReleaseEvent(copied);
+
+  slot.iteration = m_solver->iteration();
+  slot.checkpoint = _checkpoint;
+  slot.filepath = _filepath;
+  slot.header = _header;
+
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_pending.push_back(m_next);
+  }
+  m_queued.notify_one();
+
+  m_next = (m_next + 1) % m_slots.size();
+}
+
+void FieldStream::flush()
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  for(std::size_t i = 0; i < m_slots.size(); ++i)
+  {
+    while(m_slots[i].busy)
+      m_freed.wait(lock);
+  }
+}
+
+unsigned int FieldStream::frames() const
+{
+  return m_frames;
+}
+
+unsigned int FieldStream::stalls() const
+{
+  return m_stalls;
+}
+
+void FieldStream::writer()
+{
+  while(true)
+  {
+    std::size_t index;
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      while(m_pending.empty() && !m_exit)
+        m_queued.wait(lock);
+      if(m_pending.empty())
+        return;
+      index = m_pending.front();
+      m_pending.pop_front();
+    }
+
+    Slot &slot = m_slots[index];
+    clWaitForEvents(1, &slot.read);
+    clReleaseEvent(slot.read);
+    slot.read = NULL;
+
+    // Frames and checkpoints are always written as planar fp32
+    const float *fields = reinterpret_cast<const float*>(slot.host);
+    if(m_storage != STORAGE_FP32 || m_layout != LAYOUT_PLANAR)
+    {
+      m_unpacked.resize(2 * m_grid.size());
+      unpack_fields(m_storage, m_layout, slot.host, &m_unpacked[0], &m_unpacked[m_grid.size()], m_grid.size());
+      fields = &m_unpacked[0];
+    }
+
+    if(slot.checkpoint)
+      write_checkpoint(slot.filepath, slot.header, fields, fields + m_grid.size());
+    else
+      write(slot, fields);
+
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      slot.busy = false;
+      if(!slot.checkpoint)
+        ++m_frames;
+    }
+    m_freed.notify_all();
+  }
+}
+
+void FieldStream::write(const Slot &_slot, const float *_fields)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "_%08u.raw", _slot.iteration);
+
+  // Frames hold the a field followed by the b field, width x height x depth floats each
+  const std::string filepath = m_prefix + name;
+  std::ofstream file(filepath.c_str(), std::ios::out | std::ios::binary);
+  if(!file.is_open())
+  {
+    std::cout << "File could not be written: " << filepath << std::endl;
+    return;
+  }
+
+  for(int plane = 0; plane < 2; ++plane)
+  {
+    const float *field = _fields + plane * m_grid.size();
+    for(int y = 0; y < m_grid.rows(); ++y)
+      file.write(reinterpret_cast<const char*>(field + static_cast<std::size_t>(y) * m_grid.stride), sizeof(float) * m_grid.width);
+  }
+}
@@ -0,0 +1,28 @@
+#include <FrameScheduler.h>
+
+#include <algorithm>
+
+FrameScheduler::FrameScheduler(const double _budget, const unsigned int _fixed)
+  : m_budget(_budget)
+  , m_adaptive(_fixed == 0)
+  , m_steps(_fixed ? _fixed : 1)
+{;}
+
+unsigned int FrameScheduler::steps() const
+{
+  return m_steps;
+}
+
+void FrameScheduler::record(const unsigned int _steps, const double _seconds)
+{
+  if(!m_adaptive || _steps == 0)
+    return;
+
+  // Scale towards the count that fills the budget, at most doubling or halving per frame
+  double target = 2.0 * m_steps;
+  if(_seconds > 0.0)
+    target = std::min(target, _steps * SCHEDULER_FILL * m_budget / _seconds);
+  target = std::max(target, 0.5 * m_steps);
+
+  m_steps = static_cast<unsigned int>(std::min(std::max(target, 1.0), static_cast<double>(SCHEDULER_MAX_STEPS)));
+}
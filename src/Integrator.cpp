@@ -0,0 +1,97 @@
+#include <Integrator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+// Heun's method and the classic fourth order Runge-Kutta method
+static const float RK2_WEIGHTS[] = {0.5f, 0.5f};
+static const float RK2_SCALES[] = {1.f, 0.f};
+static const float RK4_WEIGHTS[] = {1.f / 6.f, 1.f / 3.f, 1.f / 3.f, 1.f / 6.f};
+static const float RK4_SCALES[] = {0.5f, 0.5f, 1.f, 0.f};
+
+Integrator integrator_from_name(const std::string &_name)
+{
+  if(_name == "euler")
+    return INTEGRATOR_EULER;
+  if(_name == "rk2")
+    return INTEGRATOR_RK2;
+  if(_name == "rk4")
+    return INTEGRATOR_RK4;
+
+  std::cout << "Unknown integrator " << _name << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+const char* integrator_name(const Integrator _integrator)
+{
+  switch(_integrator)
+  {
+    case INTEGRATOR_RK2:
+      return "rk2";
+    case INTEGRATOR_RK4:
+      return "rk4";
+    default:
+      return "euler";
+  }
+}
+
+int integrator_stages(const Integrator _integrator)
+{
+  switch(_integrator)
+  {
+    case INTEGRATOR_RK2:
+      return 2;
+    case INTEGRATOR_RK4:
+      return 4;
+    default:
+      return 1;
+  }
+}
+
+float stage_weight(const Integrator _integrator, const int _stage)
+{
+  switch(_integrator)
+  {
+    case INTEGRATOR_RK2:
+      return RK2_WEIGHTS[_stage];
+    case INTEGRATOR_RK4:
+      return RK4_WEIGHTS[_stage];
+    default:
+      return 1.f;
+  }
+}
+
+float stage_scale(const Integrator _integrator, const int _stage)
+{
+  switch(_integrator)
+  {
+    case INTEGRATOR_RK2:
+      return RK2_SCALES[_stage];
+    case INTEGRATOR_RK4:
+      return RK4_SCALES[_stage];
+    default:
+      return 0.f;
+  }
+}
+
+float stable_delta(const InputData &_input, const Integrator _integrator, const float _radius)
+{
+  // Euler and Heun's method are stable down to -2 on the real axis, RK4 to about -2.785
+  const float reach = _integrator == INTEGRATOR_RK4 ? 2.785f : 2.f;
+  return reach / (_radius * std::max(_input.Da, _input.Db));
+}
+
+float adapt_delta(const float _delta, const float _change, const float _target, const float _limit)
+{
+  // A field that stopped changing can take the largest step, one that
+  // overflowed the smallest
+  float factor = ADAPT_SHRINK;
+  if(_change == 0.f)
+    factor = ADAPT_GROWTH;
+  else if(_change > 0.f && std::isfinite(_change))
+    factor = std::min(ADAPT_GROWTH, std::max(ADAPT_SHRINK, _target / _change));
+
+  return std::min(_delta * factor, _limit);
+}
@@ -0,0 +1,691 @@
+#include <Model.h>
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Bit exact OpenCL literal of a float
+static std::string literal(const float _value)
+{
+  char text[64];
+  snprintf(text, sizeof(text), _value < 0.f ? "(%af)" : "%af", _value);
+  return text;
+}
+
+static std::string index_text(const int _value)
+{
+  char text[16];
+  snprintf(text, sizeof(text), "%d", _value);
+  return text;
+}
+
+// Functions reactions may call and the arguments they take
+static int function_arguments(const std::string &_name)
+{
+  if(_name == "exp" || _name == "sqrt" || _name == "abs")
+    return 1;
+  if(_name == "pow" || _name == "min" || _name == "max")
+    return 2;
+  return 0;
+}
+
+static bool is_identifier(const std::string &_name)
+{
+  if(_name.empty() || !(isalpha(static_cast<unsigned char>(_name[0])) || _name[0] == '_'))
+    return false;
+  for(std::size_t i = 1; i < _name.size(); ++i)
+  {
+    if(!(isalnum(static_cast<unsigned char>(_name[i])) || _name[i] == '_'))
+      return false;
+  }
+  return true;
+}
+
+static void skip_space(const std::string &_text, std::size_t &_position)
+{
+  while(_position < _text.size() && isspace(static_cast<unsigned char>(_text[_position])))
+    ++_position;
+}
+
+Model::Model(const std::string &_filepath)
+  : m_filepath(_filepath)
+  , m_delta(1.f)
+  , m_registers(0)
+{
+  // Named after the file without its directory and extension
+  const std::size_t slash = _filepath.find_last_of("/\\");
+  m_name = _filepath.substr(slash == std::string::npos ? 0 : slash + 1);
+  m_name = m_name.substr(0, m_name.find('.'));
+
+  std::ifstream file(_filepath.c_str());
+  if(!file.is_open())
+  {
+    std::cout << "Model " << _filepath << " could not be opened." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  std::string line;
+  for(int number = 1; std::getline(file, line); ++number)
+    parseStatement(line.substr(0, line.find('#')), number);
+
+  if(m_species.empty())
+    fail(0, "no species are declared");
+
+  // Reactions may use parameters declared after them
+  m_reaction.assign(m_species.size(), -1);
+  for(std::size_t i = 0; i < m_species.size(); ++i)
+  {
+    if(m_reaction_text[i].empty())
+      continue;
+
+    std::size_t position = 0;
+    m_reaction[i] = parseSum(m_reaction_text[i], position, m_reaction_line[i]);
+    skip_space(m_reaction_text[i], position);
+    if(position != m_reaction_text[i].size())
+      fail(m_reaction_line[i], "unexpected " + m_reaction_text[i].substr(position));
+  }
+
+  for(std::size_t i = 0; i < m_species.size(); ++i)
+  {
+    if(std::isnan(m_seeded[i]))
+      m_seeded[i] = m_initial[i];
+  }
+
+  compileUpdates();
+}
+
+const std::string& Model::name() const
+{
+  return m_name;
+}
+
+int Model::species() const
+{
+  return static_cast<int>(m_species.size());
+}
+
+const std::string& Model::speciesName(const int _species) const
+{
+  return m_species[_species];
+}
+
+float Model::initial(const int _species) const
+{
+  return m_initial[_species];
+}
+
+float Model::seeded(const int _species) const
+{
+  return m_seeded[_species];
+}
+
+float Model::delta() const
+{
+  return m_delta;
+}
+
+void Model::fail(const int _line, const std::string &_message) const
+{
+  std::cout << "Model " << m_filepath;
+  if(_line > 0)
+    std::cout << " line " << _line;
+  std::cout << ": " << _message << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+void Model::parseStatement(const std::string &_line, const int _number)
+{
+  std::istringstream stream(_line);
+  std::string keyword;
+  if(!(stream >> keyword))
+    return;
+
+  // Values are read whole so trailing garbage is caught
+  std::string name, value;
+  char *end = NULL;
+  float number = 0.f;
+  if(keyword == "diffusion" || keyword == "initial" || keyword == "seeded" || keyword == "parameter" || keyword == "delta")
+  {
+    if(keyword != "delta")
+      stream >> name;
+    std::string extra;
+    if(!(stream >> value) || stream >> extra)
+      fail(_number, keyword + " expects " + (keyword == "delta" ? "a value" : "a name and a value"));
+
+    number = strtof(value.c_str(), &end);
+    if(*end != '\0' || !std::isfinite(number))
+      fail(_number, value + " is not a number");
+  }
+
+  if(keyword == "species")
+  {
+    if(!m_species.empty())
+      fail(_number, "species are already declared");
+
+    while(stream >> name)
+    {
+      if(!is_identifier(name) || function_arguments(name) > 0)
+        fail(_number, name + " is not a valid species name");
+      for(std::size_t i = 0; i < m_species.size(); ++i)
+      {
+        if(m_species[i] == name)
+          fail(_number, name + " is declared twice");
+      }
+      m_species.push_back(name);
+    }
+    if(m_species.empty())
+      fail(_number, "species expects at least one name");
+
+    m_diffusion.assign(m_species.size(), 0.f);
+    m_initial.assign(m_species.size(), 0.f);
+    m_seeded.assign(m_species.size(), NAN);
+    m_reaction_text.assign(m_species.size(), std::string());
+    m_reaction_line.assign(m_species.size(), 0);
+  }
+  else if(keyword == "diffusion")
+  {
+    m_diffusion[speciesIndex(name, _number)] = number;
+  }
+  else if(keyword == "initial")
+  {
+    m_initial[speciesIndex(name, _number)] = number;
+  }
+  else if(keyword == "seeded")
+  {
+    m_seeded[speciesIndex(name, _number)] = number;
+  }
+  else if(keyword == "delta")
+  {
+    if(number <= 0.f)
+      fail(_number, "delta must be positive");
+    m_delta = number;
+  }
+  else if(keyword == "parameter")
+  {
+    if(!is_identifier(name) || function_arguments(name) > 0)
+      fail(_number, name + " is not a valid parameter name");
+    for(std::size_t i = 0; i < m_species.size(); ++i)
+    {
+      if(m_species[i] == name)
+        fail(_number, name + " is already a species");
+    }
+    for(std::size_t i = 0; i < m_parameters.size(); ++i)
+    {
+      if(m_parameters[i] == name)
+        fail(_number, name + " is declared twice");
+    }
+    m_parameters.push_back(name);
+    m_values.push_back(number);
+  }
+  else if(keyword == "reaction")
+  {
+    stream >> name;
+    const int species = speciesIndex(name, _number);
+    std::getline(stream, value);
+    m_reaction_text[species] = value;
+    m_reaction_line[species] = _number;
+
+    std::size_t position = 0;
+    skip_space(value, position);
+    if(position == value.size())
+      fail(_number, "reaction of " + name + " is empty");
+  }
+  else
+  {
+    fail(_number, "unknown statement " + keyword);
+  }
+}
+
+int Model::speciesIndex(const std::string &_name, const int _line) const
+{
+  for(std::size_t i = 0; i < m_species.size(); ++i)
+  {
+    if(m_species[i] == _name)
+      return static_cast<int>(i);
+  }
+
+  fail(_line, m_species.empty() ? "species must be declared first" : "unknown species " + _name);
+  return -1;
+}
+
+int Model::parseSum(const std::string &_text, std::size_t &_position, const int _line)
+{
+  int left = parseProduct(_text, _position, _line);
+  while(true)
+  {
+    skip_space(_text, _position);
+    if(_position >= _text.size() || (_text[_position] != '+' && _text[_position] != '-'))
+      return left;
+
+    Node node = {NODE_BINARY, 0.f, -1, std::string(), _text[_position++], left, -1};
+    node.right = parseProduct(_text, _position, _line);
+    left = addNode(node);
+  }
+}
+
+int Model::parseProduct(const std::string &_text, std::size_t &_position, const int _line)
+{
+  int left = parseUnary(_text, _position, _line);
+  while(true)
+  {
+    skip_space(_text, _position);
+    if(_position >= _text.size() || (_text[_position] != '*' && _text[_position] != '/'))
+      return left;
+
+    Node node = {NODE_BINARY, 0.f, -1, std::string(), _text[_position++], left, -1};
+    node.right = parseUnary(_text, _position, _line);
+    left = addNode(node);
+  }
+}
+
+int Model::parseUnary(const std::string &_text, std::size_t &_position, const int _line)
+{
+  skip_space(_text, _position);
+  if(_position < _text.size() && _text[_position] == '+')
+  {
+    ++_position;
+    return parseUnary(_text, _position, _line);
+  }
+  if(_position < _text.size() && _text[_position] == '-')
+  {
+    ++_position;
+    Node node = {NODE_NEGATE, 0.f, -1, std::string(), '-', -1, -1};
+    node.left = parseUnary(_text, _position, _line);
+    return addNode(node);
+  }
+
+  return parsePrimary(_text, _position, _line);
+}
+
+int Model::parsePrimary(const std::string &_text, std::size_t &_position, const int _line)
+{
+  skip_space(_text, _position);
+  if(_position >= _text.size())
+    fail(_line, "reaction ends early");
+
+  const char next = _text[_position];
+  if(next == '(')
+  {
+    ++_position;
+    const int node = parseSum(_text, _position, _line);
+    skip_space(_text, _position);
+    if(_position >= _text.size() || _text[_position] != ')')
+      fail(_line, "missing )");
+    ++_position;
+    return node;
+  }
+
+  if(isdigit(static_cast<unsigned char>(next)) || next == '.')
+  {
+    const char *begin = _text.c_str() + _position;
+    char *end = NULL;
+    const float value = strtof(begin, &end);
+    if(end == begin || !std::isfinite(value))
+      fail(_line, "invalid number " + _text.substr(_position));
+    _position += end - begin;
+
+    const Node node = {NODE_NUMBER, value, -1, std::string(), 0, -1, -1};
+    return addNode(node);
+  }
+
+  const std::size_t begin = _position;
+  while(_position < _text.size() && (isalnum(static_cast<unsigned char>(_text[_position])) || _text[_position] == '_'))
+    ++_position;
+  const std::string name = _text.substr(begin, _position - begin);
+  if(name.empty())
+    fail(_line, "unexpected " + _text.substr(begin));
+
+  const int arguments = function_arguments(name);
+  if(arguments > 0)
+  {
+    skip_space(_text, _position);
+    if(_position >= _text.size() || _text[_position] != '(')
+      fail(_line, name + " needs its arguments in parentheses");
+    ++_position;
+
+    Node node = {NODE_CALL, 0.f, -1, name, 0, -1, -1};
+    node.left = parseSum(_text, _position, _line);
+    skip_space(_text, _position);
+    if(arguments == 2)
+    {
+      if(_position >= _text.size() || _text[_position] != ',')
+        fail(_line, name + " takes two arguments");
+      ++_position;
+      node.right = parseSum(_text, _position, _line);
+      skip_space(_text, _position);
+    }
+    if(_position >= _text.size() || _text[_position] != ')')
+      fail(_line, "missing ) after the arguments of " + name);
+    ++_position;
+    return addNode(node);
+  }
+
+  for(std::size_t i = 0; i < m_species.size(); ++i)
+  {
+    if(m_species[i] == name)
+    {
+      const Node node = {NODE_SPECIES, 0.f, static_cast<int>(i), name, 0, -1, -1};
+      return addNode(node);
+    }
+  }
+
+  // Parameters are folded in as numbers
+  for(std::size_t i = 0; i < m_parameters.size(); ++i)
+  {
+    if(m_parameters[i] == name)
+    {
+      const Node node = {NODE_NUMBER, m_values[i], -1, std::string(), 0, -1, -1};
+      return addNode(node);
+    }
+  }
+
+  fail(_line, "unknown name " + name);
+  return -1;
+}
+
+int Model::addNode(const Node &_node)
+{
+  // Arithmetic on numbers alone is folded in single precision, as the device would round it
+  Node node = _node;
+  if(node.kind == NODE_NEGATE && m_nodes[node.left].kind == NODE_NUMBER)
+  {
+    node.kind = NODE_NUMBER;
+    node.value = -m_nodes[node.left].value;
+  }
+  else if(node.kind == NODE_BINARY && m_nodes[node.left].kind == NODE_NUMBER && m_nodes[node.right].kind == NODE_NUMBER)
+  {
+    const float left = m_nodes[node.left].value;
+    const float right = m_nodes[node.right].value;
+    switch(node.op)
+    {
+      case '+': node.value = left + right; break;
+      case '-': node.value = left - right; break;
+      case '*': node.value = left * right; break;
+      default: node.value = left / right; break;
+    }
+    node.kind = NODE_NUMBER;
+    if(!std::isfinite(node.value))
+    {
+      std::cout << "Model " << m_filepath << ": a constant expression is not finite" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  m_nodes.push_back(node);
+  return static_cast<int>(m_nodes.size()) - 1;
+}
+
+void Model::flatten(const int _node, const char _sign, std::vector<char> *_signs, std::vector<int> *_nodes) const
+{
+  // Only the left spine of a chain of sums is split, so terms add up in the order written
+  const Node &node = m_nodes[_node];
+  if(node.kind == NODE_BINARY && (node.op == '+' || node.op == '-'))
+  {
+    flatten(node.left, _sign, _signs, _nodes);
+    _signs->push_back(node.op == _sign ? '+' : '-');
+    _nodes->push_back(node.right);
+    return;
+  }
+
+  // A leading negation becomes a subtraction, which rounds the same
+  if(node.kind == NODE_NEGATE && !(m_nodes[node.left].kind == NODE_BINARY && (m_nodes[node.left].op == '+' || m_nodes[node.left].op == '-')))
+  {
+    _signs->push_back(_sign == '+' ? '-' : '+');
+    _nodes->push_back(node.left);
+    return;
+  }
+
+  _signs->push_back(_sign);
+  _nodes->push_back(_node);
+}
+
+void Model::rateTerms(const int _species, std::vector<char> *_signs, std::vector<int> *_nodes) const
+{
+  _signs->clear();
+  _nodes->clear();
+  if(m_reaction[_species] >= 0)
+    flatten(m_reaction[_species], '+', _signs, _nodes);
+}
+
+std::string Model::emit(const int _node) const
+{
+  const Node &node = m_nodes[_node];
+  switch(node.kind)
+  {
+    case NODE_NUMBER:
+      return literal(node.value);
+    case NODE_SPECIES:
+      return "c[" + index_text(node.species) + "]";
+    case NODE_NEGATE:
+      return "(-" + emit(node.left) + ")";
+    case NODE_BINARY:
+      return "(" + emit(node.left) + " " + node.op + " " + emit(node.right) + ")";
+    default:
+      break;
+  }
+
+  if(node.name == "abs")
+    return "fabs(" + emit(node.left) + ")";
+  if(node.name == "min" || node.name == "max")
+    return "f" + node.name + "(" + emit(node.left) + ", " + emit(node.right) + ")";
+  if(node.right >= 0)
+    return node.name + "(" + emit(node.left) + ", " + emit(node.right) + ")";
+  return node.name + "(" + emit(node.left) + ")";
+}
+
+std::string Model::openclSource() const
+{
+  std::string source = "// Generated from " + m_filepath + "\n";
+  source += "#define MODEL_SPECIES " + index_text(species()) + "\n\n";
+  source += "static void model_update(float* c, const float* l)\n{\n";
+
+  // Every rate reads the cells before any of them is replaced
+  std::vector<char> signs;
+  std::vector<int> nodes;
+  for(int i = 0; i < species(); ++i)
+  {
+    rateTerms(i, &signs, &nodes);
+
+    std::string rate;
+    std::size_t first = 0;
+    if(m_diffusion[i] != 0.f)
+    {
+      rate = literal(m_diffusion[i]) + " * l[" + index_text(i) + "]";
+    }
+    else if(!nodes.empty())
+    {
+      rate = (signs[0] == '-' ? "-" : "") + emit(nodes[0]);
+      first = 1;
+    }
+    else
+    {
+      rate = "0.f";
+    }
+
+    for(std::size_t t = first; t < nodes.size(); ++t)
+      rate = "(" + rate + " " + signs[t] + " " + emit(nodes[t]) + ")";
+    source += "  const float r" + index_text(i) + " = " + rate + ";\n";
+  }
+
+  for(int i = 0; i < species(); ++i)
+    source += "  c[" + index_text(i) + "] = c[" + index_text(i) + "] + r" + index_text(i) + " * " + literal(m_delta) + ";\n";
+
+  return source + "}\n\n";
+}
+
+const std::vector<ModelInstruction>& Model::program() const
+{
+  return m_program;
+}
+
+int Model::registers() const
+{
+  return m_registers;
+}
+
+int Model::nextRegister(const int _species) const
+{
+  return m_next[_species];
+}
+
+std::size_t Model::scratchFloats() const
+{
+  return static_cast<std::size_t>(m_registers - 2 * species()) * MODEL_CHUNK;
+}
+
+int Model::instruction(const ModelOp _op, const int _left, const int _right, const float _value)
+{
+  const ModelInstruction instruction = {_op, m_registers++, _left, _right, _value};
+  m_program.push_back(instruction);
+  return instruction.target;
+}
+
+int Model::compile(const int _node)
+{
+  const Node &node = m_nodes[_node];
+  switch(node.kind)
+  {
+    case NODE_NUMBER:
+      return instruction(OP_CONSTANT, -1, -1, node.value);
+    case NODE_SPECIES:
+      return node.species;
+    case NODE_NEGATE:
+      return instruction(OP_NEGATE, compile(node.left), -1, 0.f);
+    case NODE_BINARY:
+    {
+      const int left = compile(node.left);
+      const int right = compile(node.right);
+      const ModelOp op = node.op == '+' ? OP_ADD : node.op == '-' ? OP_SUBTRACT : node.op == '*' ? OP_MULTIPLY : OP_DIVIDE;
+      return instruction(op, left, right, 0.f);
+    }
+    default:
+      break;
+  }
+
+  const int left = compile(node.left);
+  if(node.name == "exp")
+    return instruction(OP_EXP, left, -1, 0.f);
+  if(node.name == "sqrt")
+    return instruction(OP_SQRT, left, -1, 0.f);
+  if(node.name == "abs")
+    return instruction(OP_ABS, left, -1, 0.f);
+
+  const int right = compile(node.right);
+  const ModelOp op = node.name == "pow" ? OP_POW : node.name == "min" ? OP_MIN : OP_MAX;
+  return instruction(op, left, right, 0.f);
+}
+
+void Model::compileUpdates()
+{
+  // Mirrors openclSource term by term
+  m_registers = 2 * species();
+  m_program.clear();
+  m_next.assign(species(), -1);
+
+  std::vector<char> signs;
+  std::vector<int> nodes;
+  std::vector<int> rates(species());
+  for(int i = 0; i < species(); ++i)
+  {
+    rateTerms(i, &signs, &nodes);
+
+    int rate = -1;
+    std::size_t first = 0;
+    if(m_diffusion[i] != 0.f)
+    {
+      rate = instruction(OP_MULTIPLY, instruction(OP_CONSTANT, -1, -1, m_diffusion[i]), species() + i, 0.f);
+    }
+    else if(!nodes.empty())
+    {
+      rate = compile(nodes[0]);
+      if(signs[0] == '-')
+        rate = instruction(OP_NEGATE, rate, -1, 0.f);
+      first = 1;
+    }
+    else
+    {
+      rate = instruction(OP_CONSTANT, -1, -1, 0.f);
+    }
+
+    for(std::size_t t = first; t < nodes.size(); ++t)
+      rate = instruction(signs[t] == '+' ? OP_ADD : OP_SUBTRACT, rate, compile(nodes[t]), 0.f);
+    rates[i] = rate;
+  }
+
+  const int delta = instruction(OP_CONSTANT, -1, -1, m_delta);
+  for(int i = 0; i < species(); ++i)
+    m_next[i] = instruction(OP_ADD, i, instruction(OP_MULTIPLY, rates[i], delta, 0.f), 0.f);
+}
+
+void Model::evaluate(const float *const *_inputs, float *_scratch, const int _count, const float **_registers) const
+{
+  const int inputs = 2 * species();
+  for(int i = 0; i < inputs; ++i)
+    _registers[i] = _inputs[i];
+  for(int i = inputs; i < m_registers; ++i)
+    _registers[i] = _scratch + static_cast<std::size_t>(i - inputs) * MODEL_CHUNK;
+
+  for(std::size_t p = 0; p < m_program.size(); ++p)
+  {
+    const ModelInstruction &instruction = m_program[p];
+    float *out = _scratch + static_cast<std::size_t>(instruction.target - inputs) * MODEL_CHUNK;
+    const float *left = instruction.left >= 0 ? _registers[instruction.left] : NULL;
+    const float *right = instruction.right >= 0 ? _registers[instruction.right] : NULL;
+
+    switch(instruction.op)
+    {
+      case OP_CONSTANT:
+        for(int x = 0; x < _count; ++x)
+          out[x] = instruction.value;
+        break;
+      case OP_ADD:
+        for(int x = 0; x < _count; ++x)
+          out[x] = left[x] + right[x];
+        break;
+      case OP_SUBTRACT:
+        for(int x = 0; x < _count; ++x)
+          out[x] = left[x] - right[x];
+        break;
+      case OP_MULTIPLY:
+        for(int x = 0; x < _count; ++x)
+          out[x] = left[x] * right[x];
+        break;
+      case OP_DIVIDE:
+        for(int x = 0; x < _count; ++x)
+          out[x] = left[x] / right[x];
+        break;
+      case OP_NEGATE:
+        for(int x = 0; x < _count; ++x)
+          out[x] = -left[x];
+        break;
+      case OP_EXP:
+        for(int x = 0; x < _count; ++x)
+          out[x] = expf(left[x]);
+        break;
+      case OP_SQRT:
+        for(int x = 0; x < _count; ++x)
+          out[x] = sqrtf(left[x]);
+        break;
+      case OP_ABS:
+        for(int x = 0; x < _count; ++x)
+          out[x] = fabsf(left[x]);
+        break;
+      case OP_POW:
+        for(int x = 0; x < _count; ++x)
+          out[x] = powf(left[x], right[x]);
+        break;
+      case OP_MIN:
+        for(int x = 0; x < _count; ++x)
+          out[x] = fminf(left[x], right[x]);
+        break;
+      case OP_MAX:
+        for(int x = 0; x < _count; ++x)
+          out[x] = fmaxf(left[x], right[x]);
+        break;
+    }
+  }
+}
@@ -0,0 +1,103 @@
+#include <ModelClSolver.h>
+#include <Utility.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+ModelClSolver::ModelClSolver(const Grid &_grid, const Model &_model, const float *_fields, const Options &_options)
+  : m_grid(_grid)
+  , m_species(_model.species())
+  , m_iteration(0)
+{
+  m_environment = new ClEnvironment(NULL, _options.kernel_cache);
+  m_queue = m_environment->createQueue();
+
+  // The model's update comes first so the kernels below can call it
+  const std::string source = _model.openclSource() + read_file("kernels/image.cl") + read_file("kernels/model.cl");
+  char defines[256];
+  snprintf(defines, sizeof(defines), "-DGRID_WIDTH=%d -DGRID_HEIGHT=%d -DGRID_STRIDE=%d", m_grid.width, m_grid.height, m_grid.stride);
+  m_program = m_environment->buildSource(source, defines);
+
+  // Error code
+  cl_int error = CL_SUCCESS;
+  const std::size_t bytes = sizeof(float) * m_grid.size() * m_species;
+
+  m_fields[0] = clCreateBuffer(m_environment->context(), CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, bytes, const_cast<float*>(_fields), &error);
+  opencl_error_check(error);
+  m_fields[1] = clCreateBuffer(m_environment->context(), CL_MEM_READ_WRITE, bytes, NULL, &error);
+  opencl_error_check(error);
+
+  m_local[0] = _options.local_x;
+  m_local[1] = _options.local_y;
+  m_global[0] = ((m_grid.width + m_local[0] - 1) / m_local[0]) * m_local[0];
+  m_global[1] = ((m_grid.height + m_local[1] - 1) / m_local[1]) * m_local[1];
+
+  const float width = m_grid.width;
+  const float height = m_grid.height;
+  const cl_int stride = m_grid.stride;
+  const cl_int plane = static_cast<cl_int>(m_grid.size());
+  const std::size_t tile_bytes = sizeof(float) * m_species * (m_local[0] + 2) * (m_local[1] + 2);
+
+  for(int i = 0; i < 2; ++i)
+  {
+    m_kernels[i] = clCreateKernel(m_program, "model_tiled", &error);
+    opencl_error_check(error);
+
+    clSetKernelArg(m_kernels[i], 0, sizeof(cl_mem), &m_fields[1 - i]);
+    clSetKernelArg(m_kernels[i], 1, sizeof(cl_mem), &m_fields[i]);
+    clSetKernelArg(m_kernels[i], 2, sizeof(float), &width);
+    clSetKernelArg(m_kernels[i], 3, sizeof(float), &height);
+    clSetKernelArg(m_kernels[i], 4, sizeof(cl_int), &stride);
+    clSetKernelArg(m_kernels[i], 5, sizeof(cl_int), &plane);
+    clSetKernelArg(m_kernels[i], 6, tile_bytes, NULL);
+  }
+
+  // Check the work-group and the tiles of every species fit the device before any launch
+  std::size_t max_group = 0;
+  cl_ulong local_memory = 0;
+  clGetKernelWorkGroupInfo(m_kernels[0], m_environment->device(), CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_group), &max_group, NULL);
+  clGetDeviceInfo(m_environment->device(), CL_DEVICE_LOCAL_MEM_SIZE, sizeof(local_memory), &local_memory, NULL);
+  if(m_local[0] * m_local[1] > max_group || tile_bytes > local_memory)
+  {
+    std::cout << "Work-group " << m_local[0] << "x" << m_local[1] << " with " << m_species << " species does not fit the device, maximum size is " << max_group << " with " << local_memory << " bytes of local memory." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+ModelClSolver::~ModelClSolver()
+{
+  clReleaseCommandQueue(m_queue);
+  for(int i = 0; i < 2; ++i)
+  {
+    clReleaseKernel(m_kernels[i]);
+    clReleaseMemObject(m_fields[i]);
+  }
+  clReleaseProgram(m_program);
+  delete m_environment;
+}
+
+void ModelClSolver::step(const unsigned int _count)
+{
+  for(unsigned int i = 0; i < _count; ++i)
+  {
+    opencl_error_check(clEnqueueNDRangeKernel(m_queue, m_kernels[m_iteration % 2], 2, NULL, m_global, m_local, 0, NULL, NULL));
+    ++m_iteration;
+  }
+}
+
+void ModelClSolver::read(const int _species, float *_field)
+{
+  const std::size_t bytes = sizeof(float) * m_grid.size();
+  opencl_error_check(clEnqueueReadBuffer(m_queue, m_fields[m_iteration % 2], CL_TRUE, bytes * _species, bytes, _field, 0, NULL, NULL));
+}
+
+void ModelClSolver::finish()
+{
+  clFinish(m_queue);
+}
+
+unsigned int ModelClSolver::iteration() const
+{
+  return m_iteration;
+}
@@ -0,0 +1,156 @@
+#include <ModelCpuSolver.h>
+#include <Utility.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Stencil weights matching laplacian_local() in kernels/image.cl
+#define WEIGHT_EDGE 0.2f
+#define WEIGHT_CORNER 0.05f
+#define WEIGHT_CENTRE -1.f
+
+ModelCpuSolver::ModelCpuSolver(const Grid &_grid, const Model &_model, const float *_fields, const unsigned int _threads)
+  : m_grid(_grid)
+  , m_model(_model)
+  , m_iteration(0)
+  , m_pending(0)
+  , m_exit(false)
+{
+  const std::size_t bytes = sizeof(float) * m_grid.size() * m_model.species();
+  for(int i = 0; i < 2; ++i)
+  {
+    m_fields[i] = static_cast<float*>(allocate_aligned(bytes));
+    memset(m_fields[i], 0, bytes);
+  }
+  memcpy(m_fields[0], _fields, bytes);
+
+  m_thread_count = _threads ? _threads : boost::thread::hardware_concurrency();
+  m_thread_count = std::max(1u, std::min(m_thread_count, static_cast<unsigned int>(m_grid.height)));
+
+  m_start = new boost::barrier(m_thread_count + 1);
+  m_end = new boost::barrier(m_thread_count + 1);
+  m_sync = new boost::barrier(m_thread_count);
+
+  for(unsigned int i = 0; i < m_thread_count; ++i)
+    m_threads.create_thread([this, i]() { worker(i); });
+}
+
+ModelCpuSolver::~ModelCpuSolver()
+{
+  m_exit = true;
+  m_start->wait();
+  m_threads.join_all();
+
+  delete m_sync;
+  delete m_end;
+  delete m_start;
+
+  for(int i = 0; i < 2; ++i)
+    free_aligned(m_fields[i]);
+}
+
+void ModelCpuSolver::step(const unsigned int _count)
+{
+  if(_count == 0)
+    return;
+
+  // Workers run every step between the two barriers, syncing on each step
+  m_pending = _count;
+  m_start->wait();
+  m_end->wait();
+  m_iteration += _count;
+}
+
+void ModelCpuSolver::read(const int _species, float *_field)
+{
+  memcpy(_field, m_fields[m_iteration % 2] + m_grid.size() * _species, sizeof(float) * m_grid.size());
+}
+
+void ModelCpuSolver::finish()
+{
+  // Steps complete before step() returns
+}
+
+unsigned int ModelCpuSolver::iteration() const
+{
+  return m_iteration;
+}
+
+void ModelCpuSolver::worker(const unsigned int _index)
+{
+  const int row_begin = static_cast<int>((static_cast<long long>(m_grid.height) * _index) / m_thread_count);
+  const int row_end = static_cast<int>((static_cast<long long>(m_grid.height) * (_index + 1)) / m_thread_count);
+
+  // Laplacians of a chunk of every species followed by the program's registers
+  const std::size_t laplacians = static_cast<std::size_t>(m_model.species()) * MODEL_CHUNK;
+  float *scratch = static_cast<float*>(allocate_aligned(sizeof(float) * (laplacians + m_model.scratchFloats())));
+  std::vector<const float*> registers(m_model.registers());
+
+  while(true)
+  {
+    m_start->wait();
+    if(m_exit)
+      break;
+
+    for(unsigned int s = 0; s < m_pending; ++s)
+    {
+      stepRows((m_iteration + s) % 2, row_begin, row_end, scratch, &registers[0]);
+
+      // Every row must be written before the next step reads it
+      m_sync->wait();
+    }
+
+    m_end->wait();
+  }
+
+  free_aligned(scratch);
+}
+
+void ModelCpuSolver::stepRows(const int _source, const int _begin, const int _end, float *_scratch, const float **_registers)
+{
+  const int species = m_model.species();
+  const int width = m_grid.width;
+  const std::size_t plane = m_grid.size();
+  const float *in = m_fields[_source];
+  float *out = m_fields[1 - _source];
+  float *laplacians = _scratch;
+  float *registers = _scratch + static_cast<std::size_t>(species) * MODEL_CHUNK;
+
+  std::vector<const float*> inputs(2 * species);
+  for(int y = _begin; y < _end; ++y)
+  {
+    const std::size_t positive_y = static_cast<std::size_t>((y + 1) % m_grid.height) * m_grid.stride;
+    const std::size_t current_y = static_cast<std::size_t>(y) * m_grid.stride;
+    const std::size_t negative_y = static_cast<std::size_t>((y + m_grid.height - 1) % m_grid.height) * m_grid.stride;
+
+    for(int begin = 0; begin < width; begin += MODEL_CHUNK)
+    {
+      const int count = std::min(MODEL_CHUNK, width - begin);
+      for(int s = 0; s < species; ++s)
+      {
+        // Rows are ordered positive y, y, negative y, summed as the kernel does
+        const float *p = in + s * plane + positive_y;
+        const float *c = in + s * plane + current_y;
+        const float *n = in + s * plane + negative_y;
+        float *lap = laplacians + s * MODEL_CHUNK;
+        for(int i = 0; i < count; ++i)
+        {
+          const int x = begin + i;
+          const int xm = x == 0 ? width - 1 : x - 1;
+          const int xp = x == width - 1 ? 0 : x + 1;
+          lap[i] = p[xm] * WEIGHT_CORNER + p[x] * WEIGHT_EDGE + p[xp] * WEIGHT_CORNER
+          + c[xm] * WEIGHT_EDGE + c[x] * WEIGHT_CENTRE + c[xp] * WEIGHT_EDGE
+          + n[xm] * WEIGHT_CORNER + n[x] * WEIGHT_EDGE + n[xp] * WEIGHT_CORNER;
+        }
+
+        inputs[s] = c + begin;
+        inputs[species + s] = lap;
+      }
+
+      m_model.evaluate(&inputs[0], registers, count, _registers);
+      for(int s = 0; s < species; ++s)
+        memcpy(out + s * plane + current_y + begin, _registers[m_model.nextRegister(s)], sizeof(float) * count);
+    }
+  }
+}
@@ -0,0 +1,289 @@
+#include <MultiSolver.h>
+#include <Utility.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+MultiSolver::MultiSolver(const Grid &_grid, const InputData &_input, const float *_a, const float *_b, const Options &_options)
+  : m_grid(_grid)
+  , m_iteration(0)
+  , m_halo(std::max(1u, _options.halo))
+  , m_parity(0)
+  , m_input(_input)
+  , m_storage(storage_from_name(_options.storage))
+  , m_layout(layout_from_name(_options.layout))
+{
+  m_environment = new ClEnvironment(NULL, _options.kernel_cache, _options.partition);
+  m_program = m_environment->build("kernels/image.cl", storage_define(m_storage) + " " + layout_define(m_layout));
+
+  const std::size_t plane = storage_bytes(m_storage) * m_grid.size();
+  m_planes = m_layout == LAYOUT_INTERLEAVED ? 1 : 2;
+  m_row_bytes = storage_bytes(m_storage) * m_grid.stride * (m_layout == LAYOUT_INTERLEAVED ? 2 : 1);
+
+  // Every strip sends halo rows from both of its ends, which must not overlap
+  const int count = m_environment->deviceCount();
+  const int halo = m_halo;
+  if(m_grid.height / count < 2 * halo)
+  {
+    std::cout << "Each of the " << count << " strips needs at least " << 2 * halo << " rows, use a taller grid or a smaller --halo." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // Fields in the storage format, each plane a padded grid
+  std::vector<char> packed(2 * plane);
+  pack_fields(m_storage, m_layout, _a, _b, &packed[0], m_grid.size());
+
+  // Error code
+  cl_int error = CL_SUCCESS;
+  const cl_int width = m_grid.width;
+  const cl_int stride = m_grid.stride;
+
+  m_strips.resize(count);
+  for(int d = 0, row = 0; d < count; ++d)
+  {
+    Strip &strip = m_strips[d];
+    strip.rows = m_grid.height / count + (d < m_grid.height % count ? 1 : 0);
+    strip.row = row;
+    row += strip.rows;
+    strip.queue = m_environment->createQueue(0, d);
+    strip.transfer = m_environment->createQueue(0, d);
+    strip.copies[0] = NULL;
+    strip.copies[1] = NULL;
+
+    // Strip rows with their halos, wrapping around the top and bottom of the domain
+    const int local_rows = strip.rows + 2 * halo;
+    std::vector<char> staging(m_row_bytes * local_rows);
+    cl_mem buffers[2][2];
+    for(int p = 0; p < m_planes; ++p)
+    {
+      for(int r = 0; r < local_rows; ++r)
+      {
+        const int source = (strip.row - halo + r + m_grid.height) % m_grid.height;
+        memcpy(&staging[r * m_row_bytes], &packed[p * plane + source * m_row_bytes], m_row_bytes);
+      }
+
+      buffers[0][p] = clCreateBuffer(m_environment->context(), CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, staging.size(), &staging[0], &error);
+      opencl_error_check(error);
+      buffers[1][p] = clCreateBuffer(m_environment->context(), CL_MEM_READ_WRITE, staging.size(), NULL, &error);
+      opencl_error_check(error);
+    }
+
+    for(int i = 0; i < 2; ++i)
+    {
+      strip.a[i] = buffers[i][0];
+      strip.b[i] = buffers[i][m_planes - 1];
+      if(m_planes == 1)
+        clRetainMemObject(strip.b[i]);
+    }
+
+    for(int i = 0; i < 2; ++i)
+    {
+      strip.kernels[i] = clCreateKernel(m_program, "simulate_strip", &error);
+      opencl_error_check(error);
+      clSetKernelArg(strip.kernels[i], 0, sizeof(cl_mem), &strip.a[1 - i]);
+      clSetKernelArg(strip.kernels[i], 1, sizeof(cl_mem), &strip.b[1 - i]);
+      clSetKernelArg(strip.kernels[i], 2, sizeof(cl_mem), &strip.a[i]);
+      clSetKernelArg(strip.kernels[i], 3, sizeof(cl_mem), &strip.b[i]);
+      clSetKernelArg(strip.kernels[i], 4, sizeof(InputData), &m_input);
+      clSetKernelArg(strip.kernels[i], 5, sizeof(cl_int), &width);
+      clSetKernelArg(strip.kernels[i], 7, sizeof(cl_int), &stride);
+    }
+  }
+
+  std::cout << "Split " << m_grid.height << " rows across " << count << " devices with " << halo << " halo rows" << std::endl;
+}
+
+MultiSolver::~MultiSolver()
+{
+  finish();
+  for(std::size_t d = 0; d < m_strips.size(); ++d)
+  {
+    Strip &strip = m_strips[d];
+    for(int i = 0; i < 2; ++i)
+    {
+      if(strip.copies[i] != NULL)
+        clReleaseEvent(strip.copies[i]);
+      clReleaseKernel(strip.kernels[i]);
+      clReleaseMemObject(strip.b[i]);
+      clReleaseMemObject(strip.a[i]);
+    }
+    clReleaseCommandQueue(strip.transfer);
+    clReleaseCommandQueue(strip.queue);
+  }
+  clReleaseProgram(m_program);
+  delete m_environment;
+}
+
+void MultiSolver::step(const unsigned int _count)
+{
+  for(unsigned int done = 0; done < _count;)
+  {
+    const unsigned int steps = std::min(m_halo, _count - done);
+    period(steps);
+    done += steps;
+  }
+  m_iteration += _count;
+}
+
+void MultiSolver::present()
+{
+  // Nothing is displayed from the strips
+}
+
+void MultiSolver::read(float *_a, float *_b)
+{
+  const std::size_t plane = storage_bytes(m_storage) * m_grid.size();
+  std::vector<char> packed(2 * plane);
+
+  // Interior rows of each strip land at their place in the padded planes
+  for(std::size_t d = 0; d < m_strips.size(); ++d)
+  {
+    const Strip &strip = m_strips[d];
+    cl_mem buffers[] = {strip.a[m_parity], strip.b[m_parity]};
+    for(int p = 0; p < m_planes; ++p)
+      opencl_error_check(clEnqueueReadBuffer(strip.queue, buffers[p], CL_TRUE, m_halo * m_row_bytes, strip.rows * m_row_bytes, &packed[p * plane + strip.row * m_row_bytes], 0, NULL, NULL));
+  }
+
+  unpack_fields(m_storage, m_layout, &packed[0], _a, _b, m_grid.size());
+}
+
+void MultiSolver::finish()
+{
+  for(std::size_t d = 0; d < m_strips.size(); ++d)
+  {
+    clFinish(m_strips[d].queue);
+    clFinish(m_strips[d].transfer);
+  }
+}
+
+unsigned int MultiSolver::iteration() const
+{
+  return m_iteration;
+}
+
+void MultiSolver::resume(const unsigned int _iteration)
+{
+  m_iteration = _iteration;
+}
+
+void MultiSolver::parameters(const InputData &_input)
+{
+  m_input = _input;
+  for(std::size_t d = 0; d < m_strips.size(); ++d)
+  {
+    for(int i = 0; i < 2; ++i)
+      clSetKernelArg(m_strips[d].kernels[i], 4, sizeof(InputData), &m_input);
+  }
+}
+
+unsigned int MultiSolver::devices() const
+{
+  return m_strips.size();
+}
+
+void MultiSolver::period(const unsigned int _steps)
+{
+  const int halo = m_halo;
+  const int steps = _steps;
+  const std::size_t count = m_strips.size();
+  std::vector<cl_event> edges(2 * count, NULL);
+
+  // Each step shrinks the valid rows by one from both ends. The last step
+  // computes the rows neighbours need first, leaving the middle for later.
+  for(std::size_t d = 0; d < count; ++d)
+  {
+    Strip &strip = m_strips[d];
+    const int local_rows = strip.rows + 2 * halo;
+    std::vector<cl_event> wait = dependencies(d);
+    for(int s = 1; s <= steps; ++s)
+    {
+      const int source = (m_parity + s - 1) % 2;
+      if(s < steps)
+      {
+        launch(strip, source, s, local_rows - s, wait, NULL);
+      }
+      else
+      {
+        launch(strip, source, s, 2 * halo, wait, &edges[2 * d]);
+        launch(strip, source, strip.rows, local_rows - s, std::vector<cl_event>(), &edges[2 * d + 1]);
+      }
+      wait.clear();
+    }
+    clFlush(strip.queue);
+  }
+
+  // Refresh the halos of the new state on the transfer queues. Each copy also
+  // waits for its own strip's edges, the last work that reads those halos.
+  const int parity = (m_parity + steps) % 2;
+  for(std::size_t d = 0; d < count; ++d)
+  {
+    Strip &strip = m_strips[d];
+    const std::size_t up = (d + count - 1) % count;
+    const std::size_t down = (d + 1) % count;
+    const cl_event top[2] = {edges[2 * up + 1], edges[2 * d + 1]};
+    const cl_event bottom[2] = {edges[2 * down], edges[2 * d + 1]};
+
+    copyHalo(strip, 0, m_strips[up], m_strips[up].rows, 0, parity, top);
+    copyHalo(strip, 1, m_strips[down], halo, halo + strip.rows, parity, bottom);
+    clFlush(strip.transfer);
+  }
+
+  // The middle of each strip overlaps with the copies
+  for(std::size_t d = 0; d < count; ++d)
+  {
+    Strip &strip = m_strips[d];
+    if(strip.rows > 2 * halo)
+      launch(strip, (m_parity + steps - 1) % 2, 2 * halo, strip.rows, std::vector<cl_event>(), NULL);
+    clFlush(strip.queue);
+  }
+
+  for(std::size_t i = 0; i < edges.size(); ++i)
+    clReleaseEvent(edges[i]);
+  m_parity = parity;
+}
+
+void MultiSolver::launch(Strip &_strip, const int _source, const int _begin, const int _end, const std::vector<cl_event> &_wait, cl_event *_event)
+{
+  const cl_int begin = _begin;
+  std::size_t size[] = {static_cast<std::size_t>(m_grid.width), static_cast<std::size_t>(_end - _begin)};
+
+  clSetKernelArg(_strip.kernels[_source], 6, sizeof(cl_int), &begin);
+  cl_int error = clEnqueueNDRangeKernel(_strip.queue, _strip.kernels[_source], 2, NULL, size, NULL, _wait.size(), _wait.empty() ? NULL : &_wait[0], _event);
+  opencl_error_check(error);
+}
+
+void MultiSolver::copyHalo(Strip &_strip, const int _side, const Strip &_from, const int _from_row, const int _to_row, const int _parity, const cl_event _wait[2])
+{
+  if(_strip.copies[_side] != NULL)
+    clReleaseEvent(_strip.copies[_side]);
+
+  // The transfer queue is in order, so the event of the last plane covers both
+  cl_mem to[] = {_strip.a[_parity], _strip.b[_parity]};
+  cl_mem from[] = {_from.a[_parity], _from.b[_parity]};
+  for(int p = 0; p < m_planes; ++p)
+  {
+    cl_int error = clEnqueueCopyBuffer(_strip.transfer, from[p], to[p], _from_row * m_row_bytes, _to_row * m_row_bytes, m_halo * m_row_bytes,
+      p == 0 ? 2 : 0, p == 0 ? _wait : NULL, p == m_planes - 1 ? &_strip.copies[_side] : NULL);
+    opencl_error_check(error);
+  }
+}
+
+std::vector<cl_event> MultiSolver::dependencies(const std::size_t _index) const
+{
+  // Copies into this strip, and the neighbours' copies reading from it
+  const std::size_t count = m_strips.size();
+  const Strip &up = m_strips[(_index + count - 1) % count];
+  const Strip &down = m_strips[(_index + 1) % count];
+  const cl_event copies[] = {m_strips[_index].copies[0], m_strips[_index].copies[1], up.copies[1], down.copies[0]};
+
+  std::vector<cl_event> wait;
+  for(int i = 0; i < 4; ++i)
+  {
+    if(copies[i] != NULL && std::find(wait.begin(), wait.end(), copies[i]) == wait.end())
+      wait.push_back(copies[i]);
+  }
+
+  return wait;
+}
@@ -0,0 +1,448 @@
+#include <Options.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+static void print_usage(const char *_name)
+{
+  std::cout << "Usage: " << _name << " [options]" << std::endl;
+  std::cout << "  --headless         Run without a window or GL context" << std::endl;
+  std::cout << "  --steps <n>        Iterations to run in headless mode" << std::endl;
+  std::cout << "  --output <prefix>  Prefix for the final a/b field files" << std::endl;
+  std::cout << "  --size <w>x<h>     Grid dimensions, 700x500 by default, or <w>x<h>x<d> for a volume" << std::endl;
+  std::cout << "  --stencil <n>      Laplacian of volumes, 7 (default) or 27 points" << std::endl;
+  std::cout << "  --slice <z>        Plane of a volume shown in the window, the middle one by default" << std::endl;
+  std::cout << "  --config <file>    Read options from a file, one per line without dashes" << std::endl;
+  std::cout << "  --backend <name>   Solver backend, opencl (default), cpu or multi" << std::endl;
+  std::cout << "  --threads <n>      Worker threads for the cpu backend and the initial pattern, 0 for all cores" << std::endl;
+  std::cout << "  --halo <k>         Halo rows of the multi backend, exchanged every k steps, 1 by default" << std::endl;
+  std::cout << "  --partition <n>    Split devices into sub-devices of n compute units for the multi backend" << std::endl;
+  std::cout << "  --ranks <n>        Distribute a headless run over n local processes" << std::endl;
+  std::cout << "  --compare          Run both backends headless and report their difference" << std::endl;
+  std::cout << "  --kernel <name>    OpenCL solver kernel, tiled (default) or naive" << std::endl;
+  std::cout << "  --kernel-cache <d> Directory of cached program binaries, kernel-cache by default or none" << std::endl;
+  std::cout << "  --specialize <s>   Build kernels for the grid (default), all for coefficients too, or none" << std::endl;
+  std::cout << "  --local <x>x<y>    Work-group size for the tiled kernels, 16x16 by default" << std::endl;
+  std::cout << "  --block <k>        Iterations fused into each launch by temporal blocking" << std::endl;
+  std::cout << "  --integrator <name> Time integrator, euler (default), rk2 or rk4" << std::endl;
+  std::cout << "  --adaptive         Adapt the time step to the change per step, within the stability bound" << std::endl;
+  std::cout << "  --adapt-target <x> Largest change of a or b per step aimed for by --adaptive, 0.01 by default" << std::endl;
+  std::cout << "  --time <t>         Simulated time to advance in headless mode instead of --steps" << std::endl;
+  std::cout << "  --active-tiles     Only step tiles near those still changing, with the tiled kernel" << std::endl;
+  std::cout << "  --active-threshold <x> Largest change per step of a tile counted as settled, 0 by default" << std::endl;
+  std::cout << "  --map-f <a>:<b>    Vary f per cell from a on the first row to b on the last" << std::endl;
+  std::cout << "  --map-k <a>:<b>    Vary k per cell from a on the first column to b on the last" << std::endl;
+  std::cout << "  --storage <name>   Field storage, fp32 (default), half or bf16" << std::endl;
+  std::cout << "  --storage-report   Run fp32 and --storage headless and report their difference" << std::endl;
+  std::cout << "  --layout <name>    Field layout, planar (default) or interleaved a/b pairs" << std::endl;
+  std::cout << "  --stream <n>       Stream a frame of a/b to disk every n steps in headless mode" << std::endl;
+  std::cout << "  --stream-slots <n> Staging buffers in flight for streaming, 3 by default" << std::endl;
+  std::cout << "  --checkpoint <n>   Write <output>.ckpt every n steps in headless mode" << std::endl;
+  std::cout << "  --restart <file>   Resume headless from a checkpoint for a further --steps" << std::endl;
+  std::cout << "  --steps-per-frame <n> Steps between displayed frames, 0 (default) runs as many as fit" << std::endl;
+  std::cout << "  --downsample <n>   Average n x n cells per displayed pixel, 0 (default) fits the window" << std::endl;
+  std::cout << "  --pipeline         Show each frame on its own queue while the next one is stepped" << std::endl;
+  std::cout << "  --profile          Time kernels, transfers and drawing, printing percentiles" << std::endl;
+  std::cout << "  --seed <n>         Seed for the initial pattern, 0 picks one from the clock" << std::endl;
+  std::cout << "  --init <pattern>   Initial pattern of b, noise (default), spots or mask" << std::endl;
+  std::cout << "  --spots <n>        Seed n random spots, 16 by default" << std::endl;
+  std::cout << "  --spot-radius <r>  Radius of the spots in cells, 8 by default" << std::endl;
+  std::cout << "  --mask <file>      Seed b where an 8-bit PGM image, stretched over the grid, is bright" << std::endl;
+  std::cout << "  --model <file>     Run the reaction-diffusion model a description file defines headless" << std::endl;
+  std::cout << "  --bench            Time every combination of the bench lists headless" << std::endl;
+  std::cout << "  --bench-sizes <l>  Grid sizes to bench, 256x256,1024x1024,4096x4096 by default" << std::endl;
+  std::cout << "  --bench-local <l>  Work-group sizes for the tiled kernels, 8x8,16x16,32x8 by default" << std::endl;
+  std::cout << "  --bench-layouts <l> Field layouts to bench, planar,interleaved by default" << std::endl;
+  std::cout << "  --bench-backends <l> Backends to bench, opencl,cpu by default" << std::endl;
+  std::cout << "  --bench-steps <n>  Steps per timed run, 100 by default" << std::endl;
+  std::cout << "  --bench-repeats <n> Timed runs per combination, 5 by default" << std::endl;
+  std::cout << "  --sweep            Run a batched parameter sweep headless" << std::endl;
+  std::cout << "  --sweep-Da <range> Sweep values of Da as min:max:count or a single value" << std::endl;
+  std::cout << "  --sweep-Db <range> Sweep values of Db" << std::endl;
+  std::cout << "  --sweep-f <range>  Sweep values of f" << std::endl;
+  std::cout << "  --sweep-k <range>  Sweep values of k" << std::endl;
+}
+
+// Fetch the value following an option, exiting if it is missing
+static const std::string& option_value(const std::vector<std::string> &_args, std::size_t &_index)
+{
+  if(_index + 1 >= _args.size())
+  {
+    std::cout << "Missing value for option " << _args[_index] << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  return _args[++_index];
+}
+
+static void parse_config(Options &_options, const std::string &_filepath, const char *_name);
+
+// Apply options in order so that later ones override earlier ones
+static void parse_arguments(Options &_options, const std::vector<std::string> &_args, const char *_name)
+{
+  for(std::size_t i = 0; i < _args.size(); ++i)
+  {
+    if(_args[i] == "--headless")
+    {
+      _options.headless = true;
+    }
+    else if(_args[i] == "--steps")
+    {
+      _options.steps = strtoul(option_value(_args, i).c_str(), NULL, 10);
+    }
+    else if(_args[i] == "--output")
+    {
+      _options.output = option_value(_args, i);
+    }
+    else if(_args[i] == "--backend")
+    {
+      _options.backend = option_value(_args, i);
+      if(_options.backend != "opencl" && _options.backend != "cpu" && _options.backend != "multi")
+      {
+        std::cout << "Unknown backend " << _options.backend << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--threads")
+    {
+      _options.threads = strtoul(option_value(_args, i).c_str(), NULL, 10);
+    }
+    else if(_args[i] == "--halo")
+    {
+      _options.halo = strtoul(option_value(_args, i).c_str(), NULL, 10);
+      if(_options.halo == 0)
+        _options.halo = 1;
+    }
+    else if(_args[i] == "--partition")
+    {
+      _options.partition = strtoul(option_value(_args, i).c_str(), NULL, 10);
+    }
+    else if(_args[i] == "--ranks")
+    {
+      _options.ranks = strtoul(option_value(_args, i).c_str(), NULL, 10);
+      _options.headless = true;
+    }
+    else if(_args[i] == "--compare")
+    {
+      _options.compare = true;
+      _options.headless = true;
+    }
+    else if(_args[i] == "--kernel")
+    {
+      _options.kernel = option_value(_args, i);
+      if(_options.kernel != "tiled" && _options.kernel != "naive")
+      {
+        std::cout << "Unknown kernel " << _options.kernel << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--kernel-cache")
+    {
+      _options.kernel_cache = option_value(_args, i);
+      if(_options.kernel_cache == "none")
+        _options.kernel_cache.clear();
+    }
+    else if(_args[i] == "--specialize")
+    {
+      _options.specialize = option_value(_args, i);
+      if(_options.specialize != "none" && _options.specialize != "grid" && _options.specialize != "all")
+      {
+        std::cout << "Unknown specialization " << _options.specialize << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--local")
+    {
+      const std::string &value = option_value(_args, i);
+      if(sscanf(value.c_str(), "%ux%u", &_options.local_x, &_options.local_y) != 2 || _options.local_x == 0 || _options.local_y == 0)
+      {
+        std::cout << "Invalid work-group size " << value << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--block")
+    {
+      _options.block = strtoul(option_value(_args, i).c_str(), NULL, 10);
+      if(_options.block == 0)
+        _options.block = 1;
+    }
+    else if(_args[i] == "--integrator")
+    {
+      _options.integrator = option_value(_args, i);
+      if(_options.integrator != "euler" && _options.integrator != "rk2" && _options.integrator != "rk4")
+      {
+        std::cout << "Unknown integrator " << _options.integrator << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--adaptive")
+    {
+      _options.adaptive = true;
+    }
+    else if(_args[i] == "--adapt-target")
+    {
+      _options.adapt_target = strtof(option_value(_args, i).c_str(), NULL);
+      if(_options.adapt_target <= 0.f)
+      {
+        std::cout << "The adapt target must be positive" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--time")
+    {
+      _options.time = strtod(option_value(_args, i).c_str(), NULL);
+    }
+    else if(_args[i] == "--active-tiles")
+    {
+      _options.active_tiles = true;
+    }
+    else if(_args[i] == "--active-threshold")
+    {
+      _options.active_threshold = strtof(option_value(_args, i).c_str(), NULL);
+      if(_options.active_threshold < 0.f)
+      {
+        std::cout << "The active threshold must not be negative" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--map-f" || _args[i] == "--map-k")
+    {
+      const std::string name = _args[i];
+      const std::string value = option_value(_args, i);
+      float from = 0.f, to = 0.f;
+      if(sscanf(value.c_str(), "%f:%f", &from, &to) != 2)
+      {
+        std::cout << "Invalid range " << value << " for " << name << ", expected from:to" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      (name == "--map-f" ? _options.map_f : _options.map_k) = value;
+    }
+    else if(_args[i] == "--storage")
+    {
+      _options.storage = option_value(_args, i);
+      if(_options.storage != "fp32" && _options.storage != "half" && _options.storage != "bf16")
+      {
+        std::cout << "Unknown storage " << _options.storage << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--storage-report")
+    {
+      _options.storage_report = true;
+      _options.headless = true;
+    }
+    else if(_args[i] == "--layout")
+    {
+      _options.layout = option_value(_args, i);
+      if(_options.layout != "planar" && _options.layout != "interleaved")
+      {
+        std::cout << "Unknown layout " << _options.layout << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--stream")
+    {
+      _options.stream = strtoul(option_value(_args, i).c_str(), NULL, 10);
+    }
+    else if(_args[i] == "--stream-slots")
+    {
+      _options.stream_slots = strtoul(option_value(_args, i).c_str(), NULL, 10);
+    }
+    else if(_args[i] == "--checkpoint")
+    {
+      _options.checkpoint = strtoul(option_value(_args, i).c_str(), NULL, 10);
+    }
+    else if(_args[i] == "--restart")
+    {
+      _options.restart = option_value(_args, i);
+      _options.headless = true;
+    }
+    else if(_args[i] == "--steps-per-frame")
+    {
+      _options.steps_per_frame = strtoul(option_value(_args, i).c_str(), NULL, 10);
+    }
+    else if(_args[i] == "--downsample")
+    {
+      _options.downsample = strtoul(option_value(_args, i).c_str(), NULL, 10);
+    }
+    else if(_args[i] == "--pipeline")
+    {
+      _options.pipeline = true;
+    }
+    else if(_args[i] == "--profile")
+    {
+      _options.profile = true;
+    }
+    else if(_args[i] == "--seed")
+    {
+      _options.seed = strtoul(option_value(_args, i).c_str(), NULL, 10);
+    }
+    else if(_args[i] == "--init")
+    {
+      _options.init = option_value(_args, i);
+      if(_options.init != "noise" && _options.init != "spots" && _options.init != "mask")
+      {
+        std::cout << "Unknown initial pattern " << _options.init << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--spots")
+    {
+      _options.spots = strtoul(option_value(_args, i).c_str(), NULL, 10);
+      _options.init = "spots";
+    }
+    else if(_args[i] == "--spot-radius")
+    {
+      _options.spot_radius = atoi(option_value(_args, i).c_str());
+      if(_options.spot_radius < 0)
+      {
+        std::cout << "The spot radius must not be negative" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--mask")
+    {
+      _options.mask = option_value(_args, i);
+      _options.init = "mask";
+    }
+    else if(_args[i] == "--model")
+    {
+      _options.model = option_value(_args, i);
+      _options.headless = true;
+    }
+    else if(_args[i] == "--bench")
+    {
+      _options.bench = true;
+      _options.headless = true;
+    }
+    else if(_args[i] == "--bench-sizes")
+    {
+      _options.bench_sizes = option_value(_args, i);
+    }
+    else if(_args[i] == "--bench-local")
+    {
+      _options.bench_local = option_value(_args, i);
+    }
+    else if(_args[i] == "--bench-layouts")
+    {
+      _options.bench_layouts = option_value(_args, i);
+    }
+    else if(_args[i] == "--bench-backends")
+    {
+      _options.bench_backends = option_value(_args, i);
+    }
+    else if(_args[i] == "--bench-steps")
+    {
+      _options.bench_steps = strtoul(option_value(_args, i).c_str(), NULL, 10);
+      if(_options.bench_steps == 0)
+        _options.bench_steps = 1;
+    }
+    else if(_args[i] == "--bench-repeats")
+    {
+      _options.bench_repeats = strtoul(option_value(_args, i).c_str(), NULL, 10);
+      if(_options.bench_repeats == 0)
+        _options.bench_repeats = 1;
+    }
+    else if(_args[i] == "--sweep")
+    {
+      _options.sweep = true;
+      _options.headless = true;
+    }
+    else if(_args[i] == "--sweep-Da")
+    {
+      _options.sweep_Da = option_value(_args, i);
+    }
+    else if(_args[i] == "--sweep-Db")
+    {
+      _options.sweep_Db = option_value(_args, i);
+    }
+    else if(_args[i] == "--sweep-f")
+    {
+      _options.sweep_f = option_value(_args, i);
+    }
+    else if(_args[i] == "--sweep-k")
+    {
+      _options.sweep_k = option_value(_args, i);
+    }
+    else if(_args[i] == "--size")
+    {
+      const std::string &value = option_value(_args, i);
+      _options.depth = 1;
+      const int count = sscanf(value.c_str(), "%dx%dx%d", &_options.width, &_options.height, &_options.depth);
+      if(count < 2 || _options.width < 3 || _options.height < 3 || (count == 3 && _options.depth < 3))
+      {
+        std::cout << "Invalid grid size " << value << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--stencil")
+    {
+      _options.stencil = atoi(option_value(_args, i).c_str());
+      if(_options.stencil != 7 && _options.stencil != 27)
+      {
+        std::cout << "Unknown stencil " << _options.stencil << ", use 7 or 27" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if(_args[i] == "--slice")
+    {
+      _options.slice = atoi(option_value(_args, i).c_str());
+    }
+    else if(_args[i] == "--config")
+    {
+      parse_config(_options, option_value(_args, i), _name);
+    }
+    else if(_args[i] == "--help")
+    {
+      print_usage(_name);
+      exit(EXIT_SUCCESS);
+    }
+    else
+    {
+      std::cout << "Unknown option " << _args[i] << std::endl;
+      print_usage(_name);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+}
+
+// Config files hold one option per line without the leading dashes, for
+// example "size 8192x8192". Blank lines and lines starting with # are skipped.
+static void parse_config(Options &_options, const std::string &_filepath, const char *_name)
+{
+  std::ifstream file(_filepath.c_str());
+  if(!file.is_open())
+  {
+    std::cout << "Config file could not be opened: " << _filepath << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  std::vector<std::string> args;
+  std::string line;
+  while(std::getline(file, line))
+  {
+    std::istringstream stream(line);
+    std::string key, value;
+    if(!(stream >> key) || key[0] == '#')
+      continue;
+
+    args.push_back("--" + key);
+    if(stream >> value)
+      args.push_back(value);
+  }
+
+  parse_arguments(_options, args, _name);
+}
+
+Options parse_options(int argc, char const *argv[])
+{
+  Options options;
+  std::vector<std::string> args(argv + 1, argv + argc);
+  parse_arguments(options, args, argv[0]);
+  return options;
+}
\ No newline at end of file
@@ -7,13 +7,27 @@
 
 #include "Perlin.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <cmath>
 
+// Uniform value in [-1, 1) from the top 24 bits of a draw, exact in a float
+static float gradient(std::mt19937 &generator) {
+	return float(generator() >> 8) / 8388608.0f - 1.0f;
+}
+
 Perlin::Perlin() {
-	srand(time(NULL));
+	std::mt19937 generator(time(NULL));
+	init(generator);
+}
 
+Perlin::Perlin(unsigned int seed) {
+	std::mt19937 generator(seed);
+	init(generator);
+}
+
+void Perlin::init(std::mt19937 &generator) {
 	p = new int[256];
 	Gx = new float[256];
 	Gy = new float[256];
@@ -22,15 +36,15 @@ Perlin::Perlin() {
 	for (int i=0; i<256; ++i) {
 		p[i] = i;
 
-		Gx[i] = (float(rand()) / (RAND_MAX/2)) - 1.0f;
-		Gy[i] = (float(rand()) / (RAND_MAX/2)) - 1.0f;
-		Gz[i] = (float(rand()) / (RAND_MAX/2)) - 1.0f;
+		Gx[i] = gradient(generator);
+		Gy[i] = gradient(generator);
+		Gz[i] = gradient(generator);
 	}
 
 	int j=0;
 	int swp=0;
 	for (int i=0; i<256; i++) {
-		j = rand() & 255;
+		j = generator() & 255;
 
 		swp = p[i];
 		p[i] = p[j];
@@ -40,14 +54,14 @@ Perlin::Perlin() {
 
 Perlin::~Perlin()
 {
-	delete p;
-	delete Gx;
-	delete Gy;
-	delete Gz;
+	delete[] p;
+	delete[] Gx;
+	delete[] Gy;
+	delete[] Gz;
 }
 
 
-float Perlin::noise(float sample_x, float sample_y, float sample_z)
+float Perlin::noise(float sample_x, float sample_y, float sample_z) const
 {
 	// Unit cube vertex coordinates surrounding the sample point
 	int x0 = int(floorf(sample_x));
@@ -101,3 +115,77 @@ float Perlin::noise(float sample_x, float sample_y, float sample_z)
 
 	return value;
 }
+
+
+void Perlin::noiseRow(int begin, int end, float scale, float sample_y, float sample_z, float *out) const
+{
+	// Everything along y and z is shared by the whole row
+	int y0 = int(floorf(sample_y));
+	int y1 = y0 + 1;
+	int z0 = int(floorf(sample_z));
+	int z1 = z0 + 1;
+
+	float py0 = sample_y - float(y0);
+	float py1 = py0 - 1.0f;
+	float pz0 = sample_z - float(z0);
+	float pz1 = pz0 - 1.0f;
+
+	float wy = ((6*py0 - 15)*py0 + 10)*py0*py0*py0;
+	float wz = ((6*pz0 - 15)*pz0 + 10)*pz0*pz0*pz0;
+
+	int h00 = p[(y0 + p[z0 & 255]) & 255];
+	int h10 = p[(y1 + p[z0 & 255]) & 255];
+	int h01 = p[(y0 + p[z1 & 255]) & 255];
+	int h11 = p[(y1 + p[z1 & 255]) & 255];
+
+	int x = begin;
+	while (x < end) {
+		int x0 = int(floorf(float(x) / scale));
+		int x1 = x0 + 1;
+		// Cells up to run_end share the unit cube starting at x0, the estimate is off
+		// by at most a cell or so from rounding
+		int run_end = std::min(end, std::max(x + 1, int(float(x1) * scale)));
+		while (run_end < end && int(floorf(float(run_end) / scale)) == x0)
+			++run_end;
+		while (run_end > x + 1 && int(floorf(float(run_end - 1) / scale)) != x0)
+			--run_end;
+
+		// Gradients at the corners, named by their z, y and x offsets
+		int g[8] = {
+			p[(x0 + h00) & 255], p[(x1 + h00) & 255], p[(x0 + h10) & 255], p[(x1 + h10) & 255],
+			p[(x0 + h01) & 255], p[(x1 + h01) & 255], p[(x0 + h11) & 255], p[(x1 + h11) & 255]
+		};
+		float gx[8], gy[8], gz[8];
+		for (int i=0; i<8; ++i) {
+			gx[i] = Gx[g[i]];
+			gy[i] = Gy[g[i]];
+			gz[i] = Gz[g[i]];
+		}
+
+		for (int i=x; i<run_end; ++i) {
+			float px0 = float(i) / scale - float(x0);
+			float px1 = px0 - 1.0f;
+
+			float d000 = gx[0]*px0 + gy[0]*py0 + gz[0]*pz0;
+			float d001 = gx[1]*px1 + gy[1]*py0 + gz[1]*pz0;
+			float d010 = gx[2]*px0 + gy[2]*py1 + gz[2]*pz0;
+			float d011 = gx[3]*px1 + gy[3]*py1 + gz[3]*pz0;
+			float d100 = gx[4]*px0 + gy[4]*py0 + gz[4]*pz1;
+			float d101 = gx[5]*px1 + gy[5]*py0 + gz[5]*pz1;
+			float d110 = gx[6]*px0 + gy[6]*py1 + gz[6]*pz1;
+			float d111 = gx[7]*px1 + gy[7]*py1 + gz[7]*pz1;
+
+			float wx = ((6*px0 - 15)*px0 + 10)*px0*px0*px0;
+
+			float xa = d000 + wx*(d001 - d000);
+			float xb = d010 + wx*(d011 - d010);
+			float xc = d100 + wx*(d101 - d100);
+			float xd = d110 + wx*(d111 - d110);
+			float ya = xa + wy*(xb - xa);
+			float yb = xc + wy*(xd - xc);
+			out[i - begin] = ya + wz*(yb - ya);
+		}
+
+		x = run_end;
+	}
+}
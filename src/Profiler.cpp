@@ -0,0 +1,156 @@
+#include <Profiler.h>
+
+#include <algorithm>
+#include <cstdio>
+
+const char* profile_stage_name(const ProfileStage _stage)
+{
+  static const char *names[PROFILE_STAGES] = {"step", "acquire", "colormap", "release", "read", "draw", "frame", "overlap"};
+  return names[_stage];
+}
+
+Profiler::Profiler()
+{
+  for(int i = 0; i < PROFILE_STAGES; ++i)
+  {
+    m_samples[i].reserve(PROFILER_SAMPLES);
+    m_next[i] = 0;
+  }
+}
+
+Profiler::~Profiler()
+{
+  for(std::size_t i = 0; i < m_pending.size(); ++i)
+    clReleaseEvent(m_pending[i].event);
+  for(std::size_t i = 0; i < m_overlaps.size(); ++i)
+    clReleaseEvent(m_overlaps[i]);
+}
+
+void Profiler::record(const ProfileStage _stage, const double _milliseconds)
+{
+  // Fill the ring before overwriting its oldest sample
+  std::vector<double> &samples = m_samples[_stage];
+  if(samples.size() < PROFILER_SAMPLES)
+    samples.push_back(_milliseconds);
+  else
+    samples[m_next[_stage]] = _milliseconds;
+  m_next[_stage] = (m_next[_stage] + 1) % PROFILER_SAMPLES;
+}
+
+void Profiler::record(const ProfileStage _stage, cl_event _event, const unsigned int _steps)
+{
+  Pending pending = {_stage, _event, _steps};
+  m_pending.push_back(pending);
+
+  // Keep the backlog bounded when nobody collects between frames
+  if(m_pending.size() >= PROFILER_SAMPLES)
+    collect();
+}
+
+void Profiler::overlap(cl_event _first_begin, cl_event _first_end, cl_event _second_begin, cl_event _second_end)
+{
+  m_overlaps.push_back(_first_begin);
+  m_overlaps.push_back(_first_end);
+  m_overlaps.push_back(_second_begin);
+  m_overlaps.push_back(_second_end);
+}
+
+// Start or end time of a completed event, false while it is pending or if it failed
+static bool event_time(cl_event _event, const cl_profiling_info _info, cl_ulong *_time, bool *_pending)
+{
+  cl_int status = CL_COMPLETE;
+  clGetEventInfo(_event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+  if(status > CL_COMPLETE)
+  {
+    *_pending = true;
+    return false;
+  }
+  return status == CL_COMPLETE && clGetEventProfilingInfo(_event, _info, sizeof(*_time), _time, NULL) == CL_SUCCESS;
+}
+
+void Profiler::collect()
+{
+  // Overlaps wait for all four of their events, queues share the device clock
+  std::size_t kept_overlaps = 0;
+  for(std::size_t i = 0; i < m_overlaps.size(); i += 4)
+  {
+    cl_ulong times[4] = {0, 0, 0, 0};
+    bool pending = false;
+    bool valid = true;
+    for(int j = 0; j < 4; ++j)
+      valid = event_time(m_overlaps[i + j], j % 2 ? CL_PROFILING_COMMAND_END : CL_PROFILING_COMMAND_START, &times[j], &pending) && valid;
+    if(pending)
+    {
+      for(int j = 0; j < 4; ++j)
+        m_overlaps[kept_overlaps++] = m_overlaps[i + j];
+      continue;
+    }
+
+    if(valid)
+    {
+      const cl_ulong begin = std::max(times[0], times[2]);
+      const cl_ulong end = std::min(times[1], times[3]);
+      record(PROFILE_OVERLAP, end > begin ? (end - begin) * 1e-6 : 0.0);
+    }
+    for(int j = 0; j < 4; ++j)
+      clReleaseEvent(m_overlaps[i + j]);
+  }
+  m_overlaps.resize(kept_overlaps);
+
+  std::size_t kept = 0;
+  for(std::size_t i = 0; i < m_pending.size(); ++i)
+  {
+    cl_int status = CL_COMPLETE;
+    clGetEventInfo(m_pending[i].event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+    if(status > CL_COMPLETE)
+    {
+      m_pending[kept++] = m_pending[i];
+      continue;
+    }
+
+    // Failed commands have a negative status and no timings
+    cl_ulong start = 0, end = 0;
+    if(status == CL_COMPLETE
+      && clGetEventProfilingInfo(m_pending[i].event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL) == CL_SUCCESS
+      && clGetEventProfilingInfo(m_pending[i].event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL) == CL_SUCCESS)
+    {
+      record(m_pending[i].stage, (end - start) * 1e-6 / m_pending[i].steps);
+    }
+    clReleaseEvent(m_pending[i].event);
+  }
+  m_pending.resize(kept);
+}
+
+double Profiler::percentile(const ProfileStage _stage, const double _percent) const
+{
+  std::vector<double> samples = m_samples[_stage];
+  if(samples.empty())
+    return 0.0;
+
+  const std::size_t rank = std::min(samples.size() - 1, static_cast<std::size_t>(_percent / 100.0 * samples.size()));
+  std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+  return samples[rank];
+}
+
+void Profiler::dump(std::ostream &_stream) const
+{
+  char line[128];
+  snprintf(line, sizeof(line), "%-10s %8s %10s %10s %10s %10s %10s", "stage", "samples", "mean ms", "p50 ms", "p90 ms", "p99 ms", "max ms");
+  _stream << line << std::endl;
+
+  for(int i = 0; i < PROFILE_STAGES; ++i)
+  {
+    const std::vector<double> &samples = m_samples[i];
+    if(samples.empty())
+      continue;
+
+    double mean = 0.0;
+    for(std::size_t j = 0; j < samples.size(); ++j)
+      mean += samples[j] / samples.size();
+
+    const ProfileStage stage = static_cast<ProfileStage>(i);
+    snprintf(line, sizeof(line), "%-10s %8u %10.3f %10.3f %10.3f %10.3f %10.3f", profile_stage_name(stage), static_cast<unsigned int>(samples.size()),
+      mean, percentile(stage, 50.0), percentile(stage, 90.0), percentile(stage, 99.0), *std::max_element(samples.begin(), samples.end()));
+    _stream << line << std::endl;
+  }
+}
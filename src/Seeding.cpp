@@ -0,0 +1,228 @@
+#include <Seeding.h>
+#include <Perlin.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+SeedPattern seed_pattern_from_name(const std::string &_name)
+{
+  if(_name == "noise")
+    return SEED_NOISE;
+  if(_name == "spots")
+    return SEED_SPOTS;
+  if(_name == "mask")
+    return SEED_MASK;
+
+  std::cout << "Unknown initial pattern " << _name << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+const char* seed_pattern_name(const SeedPattern _pattern)
+{
+  switch(_pattern)
+  {
+    case SEED_SPOTS:
+      return "spots";
+    case SEED_MASK:
+      return "mask";
+    default:
+      return "noise";
+  }
+}
+
+// Scrambled 64 bits from a counter, the splitmix64 finalizer
+static boost::uint64_t mix(boost::uint64_t _value)
+{
+  _value = (_value ^ (_value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  _value = (_value ^ (_value >> 27)) * 0x94d049bb133111ebULL;
+  return _value ^ (_value >> 31);
+}
+
+// Next token of a PGM header, skipping comments
+static std::string pgm_token(std::istream &_stream)
+{
+  std::string token;
+  while(_stream >> token)
+  {
+    if(token[0] != '#')
+      return token;
+    std::getline(_stream, token);
+  }
+
+  return std::string();
+}
+
+// Read an 8-bit greyscale image in binary (P5) or plain (P2) PGM format
+static void read_pgm(const std::string &_filepath, int *_width, int *_height, std::vector<unsigned char> *_pixels)
+{
+  std::ifstream file(_filepath.c_str(), std::ios::binary);
+  const std::string magic = pgm_token(file);
+  *_width = atoi(pgm_token(file).c_str());
+  *_height = atoi(pgm_token(file).c_str());
+  const int maximum = atoi(pgm_token(file).c_str());
+  if(!file || (magic != "P5" && magic != "P2") || *_width <= 0 || *_height <= 0 || maximum <= 0 || maximum > 255)
+  {
+    std::cout << "Mask " << _filepath << " is not an 8-bit PGM image" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // A single whitespace character separates the header from binary pixels
+  _pixels->resize(static_cast<std::size_t>(*_width) * *_height);
+  if(magic == "P5")
+  {
+    file.get();
+    file.read(reinterpret_cast<char*>(&(*_pixels)[0]), _pixels->size());
+  }
+  else
+  {
+    for(std::size_t i = 0; i < _pixels->size() && file; ++i)
+      (*_pixels)[i] = static_cast<unsigned char>(atoi(pgm_token(file).c_str()));
+  }
+
+  if(!file)
+  {
+    std::cout << "Mask " << _filepath << " ends before its last pixel" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // Pixels are seeded when at least half as bright as white
+  for(std::size_t i = 0; i < _pixels->size(); ++i)
+    (*_pixels)[i] = 2 * (*_pixels)[i] >= maximum;
+}
+
+// Everything a pattern needs that is shared by the rows, built once before the
+// rows are filled in parallel
+class Seeder
+{
+public:
+  Seeder(const Options &_options, const unsigned int _seed, const Grid &_grid)
+    : m_grid(_grid)
+    , m_pattern(seed_pattern_from_name(_options.init))
+    , m_perlin(_seed)
+    , m_radius(_options.spot_radius)
+    , m_mask_width(0)
+    , m_mask_height(0)
+  {
+    if(m_pattern == SEED_SPOTS)
+    {
+      // Spot i lies where the seed's i-th counter value points, its plane
+      // in a volume where those bits mixed once more point
+      for(unsigned int i = 0; i < _options.spots; ++i)
+      {
+        const boost::uint64_t bits = mix((static_cast<boost::uint64_t>(_seed) << 32) + i);
+        m_spots.push_back(static_cast<int>((bits & 0xffffffffULL) % m_grid.width));
+        m_spots.push_back(static_cast<int>((bits >> 32) % m_grid.height));
+        m_spots.push_back(static_cast<int>(mix(bits) % m_grid.depth));
+      }
+    }
+    else if(m_pattern == SEED_MASK)
+    {
+      if(_options.mask.empty())
+      {
+        std::cout << "The mask pattern needs an image given with --mask <file.pgm>" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      read_pgm(_options.mask, &m_mask_width, &m_mask_height, &m_mask);
+    }
+  }
+
+  // Rows count through every plane of a volume
+  void rows(const int _begin, const int _end, float *_a, float *_b) const
+  {
+    std::vector<float> noise(m_pattern == SEED_NOISE ? m_grid.width : 0);
+    for(int row = _begin; row < _end; ++row)
+    {
+      float *a = _a + static_cast<std::size_t>(row) * m_grid.stride;
+      float *b = _b + static_cast<std::size_t>(row) * m_grid.stride;
+      std::fill(a, a + m_grid.stride, 1.f);
+      std::fill(b, b + m_grid.stride, 0.f);
+
+      const int y = row % m_grid.height;
+      const int z = row / m_grid.height;
+      switch(m_pattern)
+      {
+        case SEED_NOISE:
+          m_perlin.noiseRow(0, m_grid.width, NOISE_SCALE, y / NOISE_SCALE, z / NOISE_SCALE, &noise[0]);
+          for(int x = 0; x < m_grid.width; ++x)
+            b[x] = noise[x] > NOISE_THRESHOLD ? 1.f : 0.f;
+          break;
+        case SEED_SPOTS:
+          spotRow(y, z, b);
+          break;
+        case SEED_MASK:
+          maskRow(y, b);
+          break;
+      }
+    }
+  }
+
+private:
+  // Discs, or balls in a volume, wrap around the edges of the toroidal grid
+  void spotRow(const int _y, const int _z, float *_b) const
+  {
+    for(std::size_t i = 0; i < m_spots.size(); i += 3)
+    {
+      const int distance_y = std::abs(_y - m_spots[i + 1]);
+      const int distance_z = std::abs(_z - m_spots[i + 2]);
+      const int dy = std::min(distance_y, m_grid.height - distance_y);
+      const int dz = std::min(distance_z, m_grid.depth - distance_z);
+      if(dy * dy + dz * dz > m_radius * m_radius)
+        continue;
+
+      const int half = static_cast<int>(sqrtf(static_cast<float>(m_radius * m_radius - dy * dy - dz * dz)));
+      const int extent = std::min(2 * half + 1, m_grid.width);
+      for(int x = 0; x < extent; ++x)
+        _b[((m_spots[i] - half + x) % m_grid.width + m_grid.width) % m_grid.width] = 1.f;
+    }
+  }
+
+  // The image is stretched over each plane, sampling the nearest pixel
+  void maskRow(const int _y, float *_b) const
+  {
+    const std::size_t row = static_cast<std::size_t>((static_cast<long long>(_y) * m_mask_height) / m_grid.height) * m_mask_width;
+    for(int x = 0; x < m_grid.width; ++x)
+    {
+      const std::size_t column = static_cast<std::size_t>((static_cast<long long>(x) * m_mask_width) / m_grid.width);
+      _b[x] = m_mask[row + column] ? 1.f : 0.f;
+    }
+  }
+
+private:
+  Grid m_grid;
+  SeedPattern m_pattern;
+  Perlin m_perlin;
+
+  // Centres of the spots as x, y, z triples and their radius in cells
+  std::vector<int> m_spots;
+  int m_radius;
+
+  // Mask pixels as 0 or 1, row by row
+  std::vector<unsigned char> m_mask;
+  int m_mask_width;
+  int m_mask_height;
+};
+
+void seed_fields(const Options &_options, const unsigned int _seed, const Grid &_grid, float *_a, float *_b)
+{
+  const Seeder seeder(_options, _seed, _grid);
+
+  // Contiguous bands of rows, one per thread
+  unsigned int threads = _options.threads ? _options.threads : boost::thread::hardware_concurrency();
+  threads = std::max(1u, std::min(threads, static_cast<unsigned int>(_grid.rows())));
+
+  boost::thread_group group;
+  for(unsigned int i = 0; i < threads; ++i)
+  {
+    const int begin = static_cast<int>((static_cast<long long>(_grid.rows()) * i) / threads);
+    const int end = static_cast<int>((static_cast<long long>(_grid.rows()) * (i + 1)) / threads);
+    group.create_thread([&seeder, begin, end, _a, _b]() { seeder.rows(begin, end, _a, _b); });
+  }
+  group.join_all();
+}
@@ -0,0 +1,256 @@
+#include <Storage.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+Storage storage_from_name(const std::string &_name)
+{
+  if(_name == "fp32")
+    return STORAGE_FP32;
+  if(_name == "half")
+    return STORAGE_HALF;
+  if(_name == "bf16")
+    return STORAGE_BF16;
+
+  std::cout << "Unknown storage " << _name << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+const char* storage_name(const Storage _storage)
+{
+  switch(_storage)
+  {
+    case STORAGE_HALF:
+      return "half";
+    case STORAGE_BF16:
+      return "bf16";
+    default:
+      return "fp32";
+  }
+}
+
+std::size_t storage_bytes(const Storage _storage)
+{
+  return _storage == STORAGE_FP32 ? sizeof(float) : sizeof(boost::uint16_t);
+}
+
+std::string storage_define(const Storage _storage)
+{
+  switch(_storage)
+  {
+    case STORAGE_HALF:
+      return "-DSTORAGE_HALF";
+    case STORAGE_BF16:
+      return "-DSTORAGE_BF16";
+    default:
+      return "";
+  }
+}
+
+static inline boost::uint32_t float_bits(const float _value)
+{
+  boost::uint32_t bits;
+  memcpy(&bits, &_value, sizeof(bits));
+  return bits;
+}
+
+static inline float bits_float(const boost::uint32_t _bits)
+{
+  float value;
+  memcpy(&value, &_bits, sizeof(value));
+  return value;
+}
+
+boost::uint16_t float_to_half(const float _value)
+{
+  const boost::uint32_t bits = float_bits(_value);
+  const boost::uint16_t sign = static_cast<boost::uint16_t>((bits >> 16) & 0x8000);
+  const boost::uint32_t magnitude = bits & 0x7fffffff;
+
+  // NaN stays NaN, everything at or above the half overflow threshold becomes infinity
+  if(magnitude > 0x7f800000)
+    return sign | 0x7e00;
+  if(magnitude >= 0x477ff000)
+    return sign | 0x7c00;
+
+  // Subnormal halves, shift the implicit bit in and round on the dropped bits
+  if(magnitude < 0x38800000)
+  {
+    if(magnitude < 0x33000000)
+      return sign;
+    const boost::uint32_t exponent = magnitude >> 23;
+    const boost::uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+    const boost::uint32_t shift = 126 - exponent;
+    boost::uint32_t half = mantissa >> shift;
+    const boost::uint32_t remainder = mantissa & ((1u << shift) - 1);
+    const boost::uint32_t midpoint = 1u << (shift - 1);
+    if(remainder > midpoint || (remainder == midpoint && (half & 1)))
+      ++half;
+    return sign | static_cast<boost::uint16_t>(half);
+  }
+
+  // Normal halves, rebias the exponent and round the 13 dropped mantissa bits
+  boost::uint32_t half = (magnitude - 0x38000000) >> 13;
+  const boost::uint32_t remainder = magnitude & 0x1fff;
+  if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+    ++half;
+  return sign | static_cast<boost::uint16_t>(half);
+}
+
+float half_to_float(const boost::uint16_t _value)
+{
+  const boost::uint32_t sign = static_cast<boost::uint32_t>(_value & 0x8000) << 16;
+  const boost::uint32_t exponent = (_value >> 10) & 0x1f;
+  boost::uint32_t mantissa = _value & 0x3ff;
+
+  if(exponent == 0x1f)
+    return bits_float(sign | 0x7f800000 | (mantissa << 13));
+
+  if(exponent == 0)
+  {
+    if(mantissa == 0)
+      return bits_float(sign);
+
+    // Normalise a subnormal half
+    boost::uint32_t shift = 0;
+    while(!(mantissa & 0x400))
+    {
+      mantissa <<= 1;
+      ++shift;
+    }
+    return bits_float(sign | ((113 - shift) << 23) | ((mantissa & 0x3ff) << 13));
+  }
+
+  return bits_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+boost::uint16_t float_to_bf16(const float _value)
+{
+  boost::uint32_t bits = float_bits(_value);
+  bits += 0x7fff + ((bits >> 16) & 1);
+  return static_cast<boost::uint16_t>(bits >> 16);
+}
+
+float bf16_to_float(const boost::uint16_t _value)
+{
+  return bits_float(static_cast<boost::uint32_t>(_value) << 16);
+}
+
+void pack_values(const Storage _storage, const float *_in, void *_out, const std::size_t _count)
+{
+  boost::uint16_t *out = static_cast<boost::uint16_t*>(_out);
+  switch(_storage)
+  {
+    case STORAGE_HALF:
+      for(std::size_t i = 0; i < _count; ++i)
+        out[i] = float_to_half(_in[i]);
+      break;
+    case STORAGE_BF16:
+      for(std::size_t i = 0; i < _count; ++i)
+        out[i] = float_to_bf16(_in[i]);
+      break;
+    default:
+      memcpy(_out, _in, sizeof(float) * _count);
+      break;
+  }
+}
+
+void unpack_values(const Storage _storage, const void *_in, float *_out, const std::size_t _count)
+{
+  const boost::uint16_t *in = static_cast<const boost::uint16_t*>(_in);
+  switch(_storage)
+  {
+    case STORAGE_HALF:
+      for(std::size_t i = 0; i < _count; ++i)
+        _out[i] = half_to_float(in[i]);
+      break;
+    case STORAGE_BF16:
+      for(std::size_t i = 0; i < _count; ++i)
+        _out[i] = bf16_to_float(in[i]);
+      break;
+    default:
+      memcpy(_out, _in, sizeof(float) * _count);
+      break;
+  }
+}
+
+Layout layout_from_name(const std::string &_name)
+{
+  if(_name == "planar")
+    return LAYOUT_PLANAR;
+  if(_name == "interleaved")
+    return LAYOUT_INTERLEAVED;
+
+  std::cout << "Unknown layout " << _name << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+std::string layout_define(const Layout _layout)
+{
+  return _layout == LAYOUT_INTERLEAVED ? "-DLAYOUT_INTERLEAVED" : "";
+}
+
+void interleave_fields(const float *_a, const float *_b, float *_out, const std::size_t _count)
+{
+  for(std::size_t i = 0; i < _count; ++i)
+  {
+    _out[2 * i] = _a[i];
+    _out[2 * i + 1] = _b[i];
+  }
+}
+
+void deinterleave_fields(const float *_in, float *_a, float *_b, const std::size_t _count)
+{
+  for(std::size_t i = 0; i < _count; ++i)
+  {
+    _a[i] = _in[2 * i];
+    _b[i] = _in[2 * i + 1];
+  }
+}
+
+// Cells converted at a time when interleaving through a temporary buffer
+#define FIELD_CHUNK 4096
+
+void pack_fields(const Storage _storage, const Layout _layout, const float *_a, const float *_b, void *_out, const std::size_t _count)
+{
+  char *out = static_cast<char*>(_out);
+  const std::size_t bytes = storage_bytes(_storage);
+
+  if(_layout == LAYOUT_PLANAR)
+  {
+    pack_values(_storage, _a, out, _count);
+    pack_values(_storage, _b, out + bytes * _count, _count);
+    return;
+  }
+
+  float cells[2 * FIELD_CHUNK];
+  for(std::size_t i = 0; i < _count; i += FIELD_CHUNK)
+  {
+    const std::size_t count = std::min<std::size_t>(FIELD_CHUNK, _count - i);
+    interleave_fields(_a + i, _b + i, cells, count);
+    pack_values(_storage, cells, out + 2 * bytes * i, 2 * count);
+  }
+}
+
+void unpack_fields(const Storage _storage, const Layout _layout, const void *_in, float *_a, float *_b, const std::size_t _count)
+{
+  const char *in = static_cast<const char*>(_in);
+  const std::size_t bytes = storage_bytes(_storage);
+
+  if(_layout == LAYOUT_PLANAR)
+  {
+    unpack_values(_storage, in, _a, _count);
+    unpack_values(_storage, in + bytes * _count, _b, _count);
+    return;
+  }
+
+  float cells[2 * FIELD_CHUNK];
+  for(std::size_t i = 0; i < _count; i += FIELD_CHUNK)
+  {
+    const std::size_t count = std::min<std::size_t>(FIELD_CHUNK, _count - i);
+    unpack_values(_storage, in + 2 * bytes * i, cells, 2 * count);
+    deinterleave_fields(cells, _a + i, _b + i, count);
+  }
+}
@@ -0,0 +1,105 @@
+#include <SweepSolver.h>
+#include <Utility.h>
+
+SweepSolver::SweepSolver(const Grid &_grid, const std::vector<InputData> &_inputs, const float *_a, const float *_b, const std::string &_cache)
+  : m_grid(_grid)
+  , m_instances(_inputs.size())
+  , m_iteration(0)
+{
+  m_environment = new ClEnvironment(NULL, _cache);
+  m_queue = m_environment->createQueue();
+  m_program = m_environment->build("kernels/image.cl");
+
+  // Error code
+  cl_int error = CL_SUCCESS;
+  const std::size_t field_bytes = sizeof(float) * m_grid.size();
+  const std::size_t bytes = field_bytes * m_instances;
+
+  for(int i = 0; i < 2; ++i)
+  {
+    m_a[i] = clCreateBuffer(m_environment->context(), CL_MEM_READ_WRITE, bytes, NULL, &error);
+    opencl_error_check(error);
+    m_b[i] = clCreateBuffer(m_environment->context(), CL_MEM_READ_WRITE, bytes, NULL, &error);
+    opencl_error_check(error);
+  }
+
+  m_inputs = clCreateBuffer(m_environment->context(), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(InputData) * m_instances, const_cast<InputData*>(&_inputs[0]), &error);
+  opencl_error_check(error);
+
+  // Replicate the initial state into every instance
+  for(unsigned int i = 0; i < m_instances; ++i)
+  {
+    opencl_error_check(clEnqueueWriteBuffer(m_queue, m_a[0], CL_FALSE, field_bytes * i, field_bytes, _a, 0, NULL, NULL));
+    opencl_error_check(clEnqueueWriteBuffer(m_queue, m_b[0], CL_FALSE, field_bytes * i, field_bytes, _b, 0, NULL, NULL));
+  }
+  clFinish(m_queue);
+
+  const cl_int width = m_grid.width;
+  const cl_int height = m_grid.height;
+  const cl_int stride = m_grid.stride;
+
+  for(int i = 0; i < 2; ++i)
+  {
+    m_kernels[i] = clCreateKernel(m_program, "simulate_batch", &error);
+    opencl_error_check(error);
+
+    clSetKernelArg(m_kernels[i], 0, sizeof(cl_mem), &m_a[1 - i]);
+    clSetKernelArg(m_kernels[i], 1, sizeof(cl_mem), &m_b[1 - i]);
+    clSetKernelArg(m_kernels[i], 2, sizeof(cl_mem), &m_a[i]);
+    clSetKernelArg(m_kernels[i], 3, sizeof(cl_mem), &m_b[i]);
+    clSetKernelArg(m_kernels[i], 4, sizeof(cl_mem), &m_inputs);
+    clSetKernelArg(m_kernels[i], 5, sizeof(cl_int), &width);
+    clSetKernelArg(m_kernels[i], 6, sizeof(cl_int), &height);
+    clSetKernelArg(m_kernels[i], 7, sizeof(cl_int), &stride);
+  }
+}
+
+SweepSolver::~SweepSolver()
+{
+  clReleaseCommandQueue(m_queue);
+  for(int i = 0; i < 2; ++i)
+  {
+    clReleaseKernel(m_kernels[i]);
+    clReleaseMemObject(m_b[i]);
+    clReleaseMemObject(m_a[i]);
+  }
+  clReleaseMemObject(m_inputs);
+  clReleaseProgram(m_program);
+  delete m_environment;
+}
+
+void SweepSolver::step(const unsigned int _count)
+{
+  std::size_t size[] = {static_cast<std::size_t>(m_grid.width), static_cast<std::size_t>(m_grid.height), m_instances};
+
+  for(unsigned int i = 0; i < _count; ++i)
+  {
+    cl_int error = clEnqueueNDRangeKernel(m_queue, m_kernels[m_iteration % 2], 3, NULL, size, NULL, 0, NULL, NULL);
+    opencl_error_check(error);
+    ++m_iteration;
+  }
+}
+
+void SweepSolver::read(const unsigned int _instance, float *_a, float *_b)
+{
+  const std::size_t field_bytes = sizeof(float) * m_grid.size();
+  const int latest = m_iteration % 2;
+
+  opencl_error_check(clEnqueueReadBuffer(m_queue, m_a[latest], CL_TRUE, field_bytes * _instance, field_bytes, _a, 0, NULL, NULL));
+  opencl_error_check(clEnqueueReadBuffer(m_queue, m_b[latest], CL_TRUE, field_bytes * _instance, field_bytes, _b, 0, NULL, NULL));
+}
+
+void SweepSolver::finish()
+{
+  clFinish(m_queue);
+}
+
+unsigned int SweepSolver::instances() const
+{
+  return m_instances;
+}
+
+unsigned int SweepSolver::iteration() const
+{
+  return m_iteration;
+}
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include <Transport.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+  #include <poll.h>
+  #include <sys/socket.h>
+  #include <sys/wait.h>
+  #include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+Transport* Transport::spawn(const unsigned int _size)
+{
+  std::cout << "Local ranks need fork and Unix sockets, which this platform does not have." << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+Transport::~Transport()
+{
+}
+
+void Transport::progress()
+{
+}
+
+void Transport::wait()
+{
+}
+
+#else
+
+Transport* Transport::spawn(const unsigned int _size)
+{
+  const int size = _size ? _size : 1;
+
+  // Pair i links the bottom of rank i to the top of rank i + 1, wrapping around
+  std::vector<int> pairs(2 * size);
+  for(int i = 0; i < size; ++i)
+  {
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, &pairs[2 * i]) != 0)
+    {
+      std::cout << "Rank links could not be created: " << strerror(errno) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // Buffered output would otherwise be written once by every rank
+  std::cout.flush();
+
+  int rank = 0;
+  std::vector<int> children;
+  for(int r = 1; r < size; ++r)
+  {
+    const pid_t pid = fork();
+    if(pid < 0)
+    {
+      std::cout << "Rank " << r << " could not be started: " << strerror(errno) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if(pid == 0)
+    {
+      rank = r;
+      children.clear();
+      break;
+    }
+    children.push_back(pid);
+  }
+
+  // Keep this rank's two ends and close every other one
+  const int up = pairs[2 * ((rank + size - 1) % size) + 1];
+  const int down = pairs[2 * rank];
+  for(std::size_t i = 0; i < pairs.size(); ++i)
+  {
+    if(pairs[i] != up && pairs[i] != down)
+      close(pairs[i]);
+  }
+
+  Transport *transport = new Transport(rank, size, up, down);
+  transport->m_children = children;
+  return transport;
+}
+
+Transport::~Transport()
+{
+  close(m_links[LINK_UP]);
+  close(m_links[LINK_DOWN]);
+
+  for(std::size_t i = 0; i < m_children.size(); ++i)
+  {
+    int status = 0;
+    waitpid(m_children[i], &status, 0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+      std::cout << "Rank " << i + 1 << " failed" << std::endl;
+  }
+}
+
+void Transport::progress()
+{
+  for(int link = 0; link < 2; ++link)
+  {
+    while(!m_sends[link].empty())
+    {
+      Message &message = m_sends[link].front();
+      const ssize_t sent = send(m_links[link], message.data, message.bytes, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        break;
+      if(sent < 0)
+      {
+        std::cout << "Rank " << m_rank << " lost a neighbour: " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+      }
+
+      message.data += sent;
+      message.bytes -= sent;
+      if(message.bytes == 0)
+        m_sends[link].pop_front();
+    }
+
+    while(!m_receives[link].empty())
+    {
+      Message &message = m_receives[link].front();
+      const ssize_t received = recv(m_links[link], message.data, message.bytes, MSG_DONTWAIT);
+      if(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        break;
+      if(received <= 0)
+      {
+        std::cout << "Rank " << m_rank << " lost a neighbour" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+
+      message.data += received;
+      message.bytes -= received;
+      if(message.bytes == 0)
+        m_receives[link].pop_front();
+    }
+  }
+}
+
+void Transport::wait()
+{
+  progress();
+  while(pending())
+  {
+    // Sleep until a link with queued messages can move again
+    pollfd links[2];
+    for(int link = 0; link < 2; ++link)
+    {
+      links[link].fd = m_links[link];
+      links[link].events = (m_sends[link].empty() ? 0 : POLLOUT) | (m_receives[link].empty() ? 0 : POLLIN);
+      links[link].revents = 0;
+    }
+    poll(links, 2, -1);
+    progress();
+  }
+}
+
+#endif
+
+Transport::Transport(const int _rank, const int _size, const int _up, const int _down)
+  : m_rank(_rank)
+  , m_size(_size)
+{
+  m_links[LINK_UP] = _up;
+  m_links[LINK_DOWN] = _down;
+}
+
+int Transport::rank() const
+{
+  return m_rank;
+}
+
+int Transport::size() const
+{
+  return m_size;
+}
+
+void Transport::isend(const int _link, const void *_data, const std::size_t _bytes)
+{
+  Message message = {static_cast<char*>(const_cast<void*>(_data)), _bytes};
+  m_sends[_link].push_back(message);
+}
+
+void Transport::irecv(const int _link, void *_data, const std::size_t _bytes)
+{
+  Message message = {static_cast<char*>(_data), _bytes};
+  m_receives[_link].push_back(message);
+}
+
+void Transport::barrier()
+{
+  if(m_size == 1)
+    return;
+
+  // A token goes round the ring twice. Rank 0 sees it return once every rank
+  // has arrived, and the second round releases the ranks.
+  char token = 0;
+  char returned = 0;
+  for(int round = 0; round < 2; ++round)
+  {
+    if(m_rank == 0)
+    {
+      isend(LINK_DOWN, &token, 1);
+      irecv(LINK_UP, &returned, 1);
+      wait();
+    }
+    else
+    {
+      irecv(LINK_UP, &token, 1);
+      wait();
+      isend(LINK_DOWN, &token, 1);
+      wait();
+    }
+  }
+}
+
+bool Transport::pending() const
+{
+  for(int link = 0; link < 2; ++link)
+  {
+    if(!m_sends[link].empty() || !m_receives[link].empty())
+      return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,113 @@
+#include <Utility.h>
+
+#include <cstdlib>
+#include <fstream>
+
+#ifdef _WIN32
+  #include <malloc.h>
+#endif
+#include <iostream>
+
+std::string read_file(const char _filepath[])
+{
+  std::string output;
+  std::ifstream file(_filepath);
+
+  if(file.is_open())
+  {
+    std::string line;
+    while(!file.eof())
+    {
+      std::getline(file, line);
+      output.append(line + "\n");
+    }
+  }
+  else
+  {
+    std::cout << "File could not be opened." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  file.close();
+  return output;
+}
+
+void write_field(const std::string &_filepath, const float *_data, const Grid &_grid)
+{
+  std::ofstream file(_filepath.c_str(), std::ios::out | std::ios::binary);
+
+  if(!file.is_open())
+  {
+    std::cout << "File could not be written: " << _filepath << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  for(int y = 0; y < _grid.rows(); ++y)
+    file.write(reinterpret_cast<const char*>(_data + static_cast<std::size_t>(y) * _grid.stride), sizeof(float) * _grid.width);
+  file.close();
+}
+
+void write_field_rows(const std::string &_filepath, const float *_data, const Grid &_grid, const int _row, const int _rows)
+{
+  std::fstream file(_filepath.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+
+  if(!file.is_open())
+  {
+    std::cout << "File could not be written: " << _filepath << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  file.seekp(sizeof(float) * static_cast<std::size_t>(_grid.width) * _row);
+  for(int y = 0; y < _rows; ++y)
+    file.write(reinterpret_cast<const char*>(_data + static_cast<std::size_t>(y) * _grid.stride), sizeof(float) * _grid.width);
+  file.close();
+}
+
+float* allocate_field(const Grid &_grid)
+{
+  return static_cast<float*>(allocate_aligned(sizeof(float) * _grid.size()));
+}
+
+void free_field(float *_field)
+{
+  free_aligned(_field);
+}
+
+void* allocate_aligned(const std::size_t _bytes)
+{
+  const std::size_t alignment = sizeof(float) * GRID_ALIGNMENT;
+  void *memory = NULL;
+
+  #ifdef _WIN32
+    memory = _aligned_malloc(_bytes, alignment);
+  #else
+    if(posix_memalign(&memory, alignment, _bytes) != 0)
+      memory = NULL;
+  #endif
+
+  if(memory == NULL)
+  {
+    std::cout << "Could not allocate " << _bytes << " bytes for a field." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  return memory;
+}
+
+void free_aligned(void *_memory)
+{
+  #ifdef _WIN32
+    _aligned_free(_memory);
+  #else
+    free(_memory);
+  #endif
+}
+
+void opencl_error_check(const cl_int _error)
+{
+  if(_error != CL_SUCCESS)
+  {
+    std::cout << "OpenCL error: " << _error << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
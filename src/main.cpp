@@ -1,31 +1,81 @@
 #include <PlatformSpecification.h>
 #include <Framebuffer.h>
-#include <Perlin.h>
+#include <Seeding.h>
+#include <InputData.h>
+#include <Options.h>
+#include <ClSolver.h>
+#include <CpuSolver.h>
+#include <SweepSolver.h>
+#include <MultiSolver.h>
+#include <Model.h>
+#include <ModelClSolver.h>
+#include <ModelCpuSolver.h>
+#include <DistributedSolver.h>
+#include <Transport.h>
+#include <FieldStream.h>
+#include <Checkpoint.h>
+#include <Storage.h>
+#include <FrameScheduler.h>
+#include <Profiler.h>
+#include <Utility.h>
 
 #include <boost/chrono.hpp>
 #include <boost/thread.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
 #include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
 #include <string>
+#include <vector>
 
-#define WIDTH 700
-#define HEIGHT 500
-#define SIZE WIDTH * HEIGHT
+// Largest window used to display a grid, larger grids are scaled down to fit
+#define MAX_WINDOW_X 1280
+#define MAX_WINDOW_Y 800
 
-struct InputData
-{
-  float Da;
-  float Db;
-  float f;
-  float k;
-  float delta;
-};
+// Shortest time between two window title updates in milliseconds
+#define TITLE_INTERVAL 500
+
+// Time between two dumps of the --profile statistics in milliseconds
+#define PROFILE_INTERVAL 5000
+
+// Largest absolute difference accepted between backends by --compare
+#define COMPARE_TOLERANCE 1e-3f
+
+// Cells with b above this are counted as part of the pattern by --storage-report
+#define PATTERN_THRESHOLD 0.25f
 
+// Untimed steps run by --bench before timing each configuration
+#define BENCH_WARMUP 10
+
+// Host copies of the padded fields, allocated for the grid chosen at runtime
 struct SimData
 {
-  float a_current[SIZE];
-  float b_current[SIZE];
-  float a_buffer[SIZE];
-  float b_buffer[SIZE];
+  SimData(const Grid &_grid)
+    : grid(_grid)
+    , a_current(allocate_field(_grid))
+    , b_current(allocate_field(_grid))
+    , a_buffer(allocate_field(_grid))
+    , b_buffer(allocate_field(_grid))
+  {;}
+
+  ~SimData()
+  {
+    free_field(b_buffer);
+    free_field(a_buffer);
+    free_field(b_current);
+    free_field(a_current);
+  }
+
+  Grid grid;
+  float *a_current;
+  float *b_current;
+  float *a_buffer;
+  float *b_buffer;
 };
 
 // Custom key callback for changing simulation parameters
@@ -79,43 +129,775 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
   }
 }
 
-// Read file function to load source for runtime kernel compilation
-std::string read_file(const char _filepath[])
+// Seed of the initial pattern, taken from the clock unless one was given
+unsigned int initial_seed(const Options &_options)
 {
-  std::string output;
-  std::ifstream file(_filepath);
+  return _options.seed ? _options.seed : static_cast<unsigned int>(time(NULL));
+}
+
+// Initial values for simulation
+void initialise(SimData *_data, const Options &_options, const unsigned int _seed)
+{
+  seed_fields(_options, _seed, _data->grid, _data->a_current, _data->b_current);
+
+  const std::size_t bytes = sizeof(float) * _data->grid.size();
+  memset(_data->a_buffer, 0, bytes);
+  memset(_data->b_buffer, 0, bytes);
+}
+
+// Create the backend chosen on the command line
+Solver* create_solver(const std::string &_backend, const Options &_options, const InputData &_input, const Grid &_grid, const float *_a, const float *_b, Framebuffer *_framebuffer = NULL)
+{
+  if(_backend != "opencl" && (_options.adaptive || _options.integrator != "euler"))
+  {
+    std::cout << "Adaptive stepping and the Runge-Kutta integrators need the opencl backend." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if(_backend != "opencl" && _options.active_tiles)
+  {
+    std::cout << "Active tiles need the opencl backend." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if(_backend != "opencl" && _grid.depth > 1)
+  {
+    std::cout << "Volumes need the opencl backend." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if(_backend != "opencl" && (!_options.map_f.empty() || !_options.map_k.empty()))
+  {
+    std::cout << "Parameter maps need the opencl backend." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if(_backend == "cpu")
+  {
+    CpuSolver *solver = new CpuSolver(_grid, _input, _a, _b, _options.threads, storage_from_name(_options.storage), layout_from_name(_options.layout), _framebuffer, _options.downsample);
+    std::cout << "CPU backend using " << solver->kernel() << " row kernel with " << _options.layout << " " << _options.storage << " fields" << std::endl;
+    return solver;
+  }
 
-  if(file.is_open())
+  if(_backend == "multi")
   {
-    std::string line;
-    while(!file.eof())
+    if(_framebuffer != NULL)
     {
-      std::getline(file, line);
-      output.append(line + "\n");
+      std::cout << "The multi backend runs headless only." << std::endl;
+      exit(EXIT_FAILURE);
     }
+    return new MultiSolver(_grid, _input, _a, _b, _options);
+  }
+
+  return new ClSolver(_grid, _input, _a, _b, _options, _framebuffer);
+}
+
+// Profiler for --profile, fed with device timings when the backend is OpenCL
+Profiler* create_profiler(const Options &_options, Solver *_solver)
+{
+  if(!_options.profile)
+    return NULL;
+
+  Profiler *profiler = new Profiler();
+  ClSolver *cl_solver = dynamic_cast<ClSolver*>(_solver);
+  if(cl_solver != NULL)
+    cl_solver->profile(profiler);
+
+  return profiler;
+}
+
+// Simulated time a solver advanced since it was created at iteration _start,
+// and the delta of its next step
+double simulated_time(const Solver *_solver, const unsigned int _start, const InputData &_input)
+{
+  const ClSolver *cl_solver = dynamic_cast<const ClSolver*>(_solver);
+  if(cl_solver != NULL)
+    return cl_solver->time();
+
+  return static_cast<double>(_solver->iteration() - _start) * _input.delta;
+}
+
+float step_delta(const Solver *_solver, const InputData &_input)
+{
+  const ClSolver *cl_solver = dynamic_cast<const ClSolver*>(_solver);
+  return cl_solver != NULL ? cl_solver->delta() : _input.delta;
+}
+
+// Run the solver without any window or GL context at full device throughput
+int run_headless(const Options &_options, const InputData &_input)
+{
+  InputData input = _input;
+  unsigned int seed = initial_seed(_options);
+  Grid grid(_options.width, _options.height, _options.depth);
+
+  // A restart takes its grid, parameters and seed from the checkpoint
+  Checkpoint *restart = NULL;
+  if(!_options.restart.empty())
+  {
+    restart = new Checkpoint(_options.restart);
+    grid = restart->grid();
+    input = restart->header().input;
+    seed = restart->header().seed;
+  }
+
+  SimData *data = new SimData(grid);
+  Solver *solver = NULL;
+  if(restart != NULL)
+  {
+    // Upload straight from the mapped planes, skipping the noise initialisation
+    solver = create_solver(_options.backend, _options, input, grid, restart->a(), restart->b());
+    solver->resume(restart->header().iteration);
+    std::cout << "Restarted from " << _options.restart << " at iteration " << solver->iteration() << std::endl;
+    delete restart;
   }
   else
   {
-    std::cout << "File could not be opened." << std::endl;
+    initialise(data, _options, seed);
+    solver = create_solver(_options.backend, _options, input, grid, data->a_current, data->b_current);
+  }
+  std::cout << "Seed: " << seed << std::endl;
+  Profiler *profiler = create_profiler(_options, solver);
+
+  // Optional stream of frames and checkpoints written in the background while stepping
+  ClSolver *cl_solver = dynamic_cast<ClSolver*>(solver);
+  FieldStream *stream = NULL;
+  if(_options.stream > 0 && cl_solver == NULL)
+  {
+    std::cout << "Streaming requires the opencl backend." << std::endl;
     exit(EXIT_FAILURE);
   }
+  if(cl_solver != NULL && (_options.stream > 0 || _options.checkpoint > 0))
+    stream = new FieldStream(cl_solver, _options.output + "_frame", _options.stream_slots);
+
+  const std::string checkpoint_path = _options.output + ".ckpt";
+
+  // A run to a simulated time ends with the batch that reaches it, batches
+  // being no longer than the interval at which adaptive stepping changes delta
+  const unsigned int start = solver->iteration();
+  unsigned int steps = _options.time > 0.0 ? std::numeric_limits<unsigned int>::max() : _options.steps;
+
+  boost::chrono::high_resolution_clock::time_point timer_start = boost::chrono::high_resolution_clock::now();
+  for(unsigned int done = 0; done < steps;)
+  {
+    // Step up to the next frame or checkpoint, whichever comes first
+    unsigned int count = steps - done;
+    if(_options.time > 0.0)
+    {
+      const double remaining = (_options.time - simulated_time(solver, start, input)) / step_delta(solver, input);
+      count = std::max(1u, static_cast<unsigned int>(std::ceil(std::min(remaining, static_cast<double>(ADAPT_INTERVAL)))));
+    }
+    if(_options.stream > 0)
+      count = std::min(count, _options.stream - done % _options.stream);
+    if(_options.checkpoint > 0)
+      count = std::min(count, _options.checkpoint - done % _options.checkpoint);
+
+    solver->step(count);
+    done += count;
+    if(_options.time > 0.0 && simulated_time(solver, start, input) >= _options.time)
+      steps = done;
+
+    if(_options.stream > 0 && (done % _options.stream == 0 || done == steps))
+      stream->push();
+
+    if(_options.checkpoint > 0 && (done % _options.checkpoint == 0 || done == steps))
+    {
+      if(stream != NULL)
+      {
+        stream->checkpoint(checkpoint_path, input, seed);
+      }
+      else
+      {
+        // Backends without a device stream are checkpointed in place
+        solver->read(data->a_buffer, data->b_buffer);
+        write_checkpoint(checkpoint_path, checkpoint_header(grid, input, solver->iteration(), seed), data->a_buffer, data->b_buffer);
+      }
+    }
+  }
+  solver->finish();
+  boost::chrono::high_resolution_clock::time_point timer_end = boost::chrono::high_resolution_clock::now();
+
+  double seconds = boost::chrono::duration_cast<boost::chrono::duration<double> >(timer_end - timer_start).count();
+  std::cout << "Iterations: " << solver->iteration() << std::endl;
+  std::cout << "Seconds: " << seconds << std::endl;
+  std::cout << "Steps per second: " << (seconds > 0.0 ? steps / seconds : 0.0) << std::endl;
+  if(_options.time > 0.0 || _options.adaptive)
+    std::cout << "Simulated time: " << simulated_time(solver, start, input) << " with a final delta of " << step_delta(solver, input) << std::endl;
+  if(cl_solver != NULL && _options.active_tiles)
+    std::cout << "Active tiles: " << cl_solver->activeTiles() << " of " << cl_solver->tiles() << std::endl;
 
-  file.close();
-  return output;
+  if(profiler != NULL)
+  {
+    profiler->collect();
+    profiler->dump(std::cout);
+  }
+
+  if(stream != NULL)
+  {
+    stream->flush();
+    if(_options.stream > 0)
+      std::cout << "Streamed " << stream->frames() << " frames, waited on a free slot " << stream->stalls() << " times" << std::endl;
+    delete stream;
+  }
+
+  // Write the final fields as raw floats of width x height, plane after plane for volumes
+  solver->read(data->a_buffer, data->b_buffer);
+  write_field(_options.output + "_a.raw", data->a_buffer, data->grid);
+  write_field(_options.output + "_b.raw", data->b_buffer, data->grid);
+  std::cout << "Wrote " << data->grid.width << "x" << data->grid.height;
+  if(data->grid.depth > 1)
+    std::cout << "x" << data->grid.depth;
+  std::cout << " fields to " << _options.output << "_{a,b}.raw" << std::endl;
+
+  delete solver;
+  delete profiler;
+  delete data;
+
+  return EXIT_SUCCESS;
 }
 
-// Function to check OpenCL error codes
-void opencl_error_check(const cl_int _error)
+// Run headless with the grid split across local ranks, each a process
+// holding a strip of rows. Checkpoints and the final fields are written by
+// every rank in parallel, each to its own rows of the files.
+int run_distributed(const Options &_options, const InputData &_input)
 {
-  if(_error != CL_SUCCESS)
+  if(_options.storage != "fp32" || _options.layout != "planar" || _options.stream > 0)
   {
-    std::cout << "OpenCL error: " << _error << std::endl;
+    std::cout << "Distributed runs only support fp32 planar fields without streaming." << std::endl;
     exit(EXIT_FAILURE);
   }
+
+  // The seed is taken before the ranks start so that they all agree on it
+  unsigned int seed = initial_seed(_options);
+  Transport *transport = Transport::spawn(_options.ranks);
+  const bool root = transport->rank() == 0;
+
+  InputData input = _input;
+  Grid grid(_options.width, _options.height);
+  DistributedSolver *solver = NULL;
+  if(!_options.restart.empty())
+  {
+    // Every rank maps the checkpoint and copies its own rows
+    Checkpoint restart(_options.restart);
+    grid = restart.grid();
+    input = restart.header().input;
+    seed = restart.header().seed;
+    solver = new DistributedSolver(grid, input, restart.a(), restart.b(), transport);
+    solver->resume(restart.header().iteration);
+    if(root)
+      std::cout << "Restarted from " << _options.restart << " at iteration " << solver->iteration() << std::endl;
+  }
+  else
+  {
+    // Every rank generates the same noise and keeps its own rows
+    SimData *data = new SimData(grid);
+    initialise(data, _options, seed);
+    solver = new DistributedSolver(grid, input, data->a_current, data->b_current, transport);
+    delete data;
+  }
+
+  if(root)
+  {
+    std::cout << "Seed: " << seed << std::endl;
+    std::cout << "Distributed over " << transport->size() << " ranks using the " << solver->kernel() << " row kernel" << std::endl;
+  }
+
+  const std::string checkpoint_path = _options.output + ".ckpt";
+
+  transport->barrier();
+  boost::chrono::high_resolution_clock::time_point timer_start = boost::chrono::high_resolution_clock::now();
+  for(unsigned int done = 0; done < _options.steps;)
+  {
+    unsigned int count = _options.steps - done;
+    if(_options.checkpoint > 0)
+      count = std::min(count, _options.checkpoint - done % _options.checkpoint);
+
+    solver->step(count);
+    done += count;
+
+    if(_options.checkpoint > 0 && (done % _options.checkpoint == 0 || done == _options.steps))
+    {
+      const CheckpointHeader header = checkpoint_header(grid, input, solver->iteration(), seed);
+      if(root)
+        begin_checkpoint(checkpoint_path, header);
+      transport->barrier();
+      write_checkpoint_rows(checkpoint_path, header, solver->row(), solver->rows(), solver->a(), solver->b());
+      transport->barrier();
+      if(root)
+        commit_checkpoint(checkpoint_path);
+    }
+  }
+  transport->barrier();
+  boost::chrono::high_resolution_clock::time_point timer_end = boost::chrono::high_resolution_clock::now();
+
+  if(root)
+  {
+    double seconds = boost::chrono::duration_cast<boost::chrono::duration<double> >(timer_end - timer_start).count();
+    std::cout << "Iterations: " << solver->iteration() << std::endl;
+    std::cout << "Seconds: " << seconds << std::endl;
+    std::cout << "Steps per second: " << (seconds > 0.0 ? _options.steps / seconds : 0.0) << std::endl;
+
+    // Files are created empty before every rank writes its rows into them
+    std::ofstream a_file((_options.output + "_a.raw").c_str(), std::ios::out | std::ios::binary);
+    std::ofstream b_file((_options.output + "_b.raw").c_str(), std::ios::out | std::ios::binary);
+  }
+  transport->barrier();
+  write_field_rows(_options.output + "_a.raw", solver->a(), grid, solver->row(), solver->rows());
+  write_field_rows(_options.output + "_b.raw", solver->b(), grid, solver->row(), solver->rows());
+  transport->barrier();
+  if(root)
+    std::cout << "Wrote " << grid.width << "x" << grid.height << " fields to " << _options.output << "_{a,b}.raw" << std::endl;
+
+  delete solver;
+  delete transport;
+
+  return EXIT_SUCCESS;
+}
+
+// Run the OpenCL and CPU backends from the same state and compare the results
+int run_compare(const Options &_options, const InputData &_input)
+{
+  SimData *data = new SimData(Grid(_options.width, _options.height));
+  initialise(data, _options, initial_seed(_options));
+
+  const Grid &grid = data->grid;
+  std::vector<float> a[2], b[2];
+  const char *backends[] = {"opencl", "cpu"};
+  for(int i = 0; i < 2; ++i)
+  {
+    Solver *solver = create_solver(backends[i], _options, _input, grid, data->a_current, data->b_current);
+    solver->step(_options.steps);
+    a[i].resize(grid.size());
+    b[i].resize(grid.size());
+    solver->read(&a[i][0], &b[i][0]);
+    delete solver;
+  }
+
+  float difference = 0.f;
+  for(int y = 0; y < grid.height; ++y)
+  {
+    for(int x = 0; x < grid.width; ++x)
+    {
+      const std::size_t i = static_cast<std::size_t>(y) * grid.stride + x;
+      difference = std::max(difference, std::abs(a[0][i] - a[1][i]));
+      difference = std::max(difference, std::abs(b[0][i] - b[1][i]));
+    }
+  }
+
+  std::cout << "Max absolute difference after " << _options.steps << " steps: " << difference << std::endl;
+  std::cout << (difference <= COMPARE_TOLERANCE ? "Within" : "Outside") << " tolerance of " << COMPARE_TOLERANCE << std::endl;
+
+  delete data;
+
+  return difference <= COMPARE_TOLERANCE ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Run one backend with fp32 fields and with the chosen 16-bit storage from the
+// same state, then report how far the resulting patterns have drifted apart
+int run_storage_report(const Options &_options, const InputData &_input)
+{
+  if(_options.storage == "fp32")
+  {
+    std::cout << "Choose half or bf16 with --storage for the report." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  SimData *data = new SimData(Grid(_options.width, _options.height));
+  initialise(data, _options, initial_seed(_options));
+
+  const Grid &grid = data->grid;
+  std::vector<float> a[2], b[2];
+  const std::string storages[] = {"fp32", _options.storage};
+  for(int i = 0; i < 2; ++i)
+  {
+    Options options = _options;
+    options.storage = storages[i];
+    Solver *solver = create_solver(options.backend, options, _input, grid, data->a_current, data->b_current);
+    solver->step(_options.steps);
+    a[i].resize(grid.size());
+    b[i].resize(grid.size());
+    solver->read(&a[i][0], &b[i][0]);
+    delete solver;
+  }
+
+  float difference_a = 0.f, difference_b = 0.f;
+  double squares = 0.0, mean[2] = {0.0, 0.0};
+  std::size_t agree = 0;
+  for(int y = 0; y < grid.height; ++y)
+  {
+    for(int x = 0; x < grid.width; ++x)
+    {
+      const std::size_t i = static_cast<std::size_t>(y) * grid.stride + x;
+      difference_a = std::max(difference_a, std::abs(a[0][i] - a[1][i]));
+      difference_b = std::max(difference_b, std::abs(b[0][i] - b[1][i]));
+      squares += (b[0][i] - b[1][i]) * (b[0][i] - b[1][i]);
+      mean[0] += b[0][i];
+      mean[1] += b[1][i];
+      if((b[0][i] > PATTERN_THRESHOLD) == (b[1][i] > PATTERN_THRESHOLD))
+        ++agree;
+    }
+  }
+
+  const double cells = static_cast<double>(grid.cells());
+  const double megabytes = 1.0 / (1024.0 * 1024.0);
+  std::cout << "Storage report for " << _options.storage << " against fp32 after " << _options.steps << " steps on the " << _options.backend << " backend" << std::endl;
+  std::cout << "  Max absolute difference: a " << difference_a << ", b " << difference_b << std::endl;
+  std::cout << "  RMS difference of b: " << std::sqrt(squares / cells) << std::endl;
+  std::cout << "  Mean b: fp32 " << mean[0] / cells << ", " << _options.storage << " " << mean[1] / cells << std::endl;
+  std::cout << "  Pattern agreement (b > " << PATTERN_THRESHOLD << "): " << 100.0 * agree / cells << "% of cells" << std::endl;
+  std::cout << "  Memory per field: " << storage_bytes(storage_from_name(_options.storage)) * grid.size() * megabytes << " MB instead of " << sizeof(float) * grid.size() * megabytes << " MB" << std::endl;
+
+  delete data;
+
+  return EXIT_SUCCESS;
+}
+
+// Expand a sweep range given as min:max:count, or a single value, into its values
+std::vector<float> sweep_values(const std::string &_range, const float _default)
+{
+  std::vector<float> values;
+  float minimum = _default, maximum = _default;
+  unsigned int count = 1;
+
+  if(!_range.empty())
+  {
+    int fields = sscanf(_range.c_str(), "%f:%f:%u", &minimum, &maximum, &count);
+    if(fields == 1)
+    {
+      maximum = minimum;
+      count = 1;
+    }
+    else if(fields != 3 || count == 0)
+    {
+      std::cout << "Invalid sweep range " << _range << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  for(unsigned int i = 0; i < count; ++i)
+    values.push_back(count > 1 ? minimum + (maximum - minimum) * i / (count - 1) : minimum);
+
+  return values;
+}
+
+// Advance every combination of the sweep ranges in one batched job and write a snapshot of each
+int run_sweep(const Options &_options, const InputData &_input)
+{
+  std::vector<float> Da = sweep_values(_options.sweep_Da, _input.Da);
+  std::vector<float> Db = sweep_values(_options.sweep_Db, _input.Db);
+  std::vector<float> f = sweep_values(_options.sweep_f, _input.f);
+  std::vector<float> k = sweep_values(_options.sweep_k, _input.k);
+
+  std::vector<InputData> inputs;
+  for(std::size_t i = 0; i < Da.size(); ++i)
+  {
+    for(std::size_t j = 0; j < Db.size(); ++j)
+    {
+      for(std::size_t l = 0; l < f.size(); ++l)
+      {
+        for(std::size_t m = 0; m < k.size(); ++m)
+        {
+          InputData input = _input;
+          input.Da = Da[i];
+          input.Db = Db[j];
+          input.f = f[l];
+          input.k = k[m];
+          inputs.push_back(input);
+        }
+      }
+    }
+  }
+
+  SimData *data = new SimData(Grid(_options.width, _options.height));
+  initialise(data, _options, initial_seed(_options));
+
+  SweepSolver *solver = new SweepSolver(data->grid, inputs, data->a_current, data->b_current, _options.kernel_cache);
+
+  boost::chrono::high_resolution_clock::time_point timer_start = boost::chrono::high_resolution_clock::now();
+  solver->step(_options.steps);
+  solver->finish();
+  boost::chrono::high_resolution_clock::time_point timer_end = boost::chrono::high_resolution_clock::now();
+
+  double seconds = boost::chrono::duration_cast<boost::chrono::duration<double> >(timer_end - timer_start).count();
+  std::cout << "Instances: " << solver->instances() << std::endl;
+  std::cout << "Iterations: " << solver->iteration() << std::endl;
+  std::cout << "Seconds: " << seconds << std::endl;
+  std::cout << "Steps per second: " << (seconds > 0.0 ? _options.steps / seconds : 0.0) << std::endl;
+
+  // Snapshot of every instance with an index of the coefficients used
+  std::ofstream index((_options.output + "_sweep.csv").c_str());
+  index << "instance,Da,Db,f,k,a,b" << std::endl;
+  for(unsigned int i = 0; i < solver->instances(); ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "_%05u", i);
+    const std::string prefix = _options.output + name;
+
+    solver->read(i, data->a_buffer, data->b_buffer);
+    write_field(prefix + "_a.raw", data->a_buffer, data->grid);
+    write_field(prefix + "_b.raw", data->b_buffer, data->grid);
+    index << i << "," << inputs[i].Da << "," << inputs[i].Db << "," << inputs[i].f << "," << inputs[i].k << "," << prefix << "_a.raw," << prefix << "_b.raw" << std::endl;
+  }
+  std::cout << "Wrote " << solver->instances() << " snapshots indexed in " << _options.output << "_sweep.csv" << std::endl;
+
+  delete solver;
+  delete data;
+
+  return EXIT_SUCCESS;
+}
+
+// Run the model of a description file headless. Every species starts at its
+// initial value, or its seeded value where the initial pattern seeds b.
+int run_model(const Options &_options)
+{
+  if(_options.checkpoint > 0 || _options.stream > 0 || !_options.restart.empty() || _options.ranks > 0)
+  {
+    std::cout << "Models do not support checkpoints, streaming, restarts or ranks." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if(_options.backend != "opencl" && _options.backend != "cpu")
+  {
+    std::cout << "Models run on the opencl or cpu backend." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  const Model model(_options.model);
+  const unsigned int seed = initial_seed(_options);
+  SimData *data = new SimData(Grid(_options.width, _options.height));
+  initialise(data, _options, seed);
+
+  const Grid &grid = data->grid;
+  std::vector<float> fields(grid.size() * model.species());
+  for(int s = 0; s < model.species(); ++s)
+  {
+    for(std::size_t i = 0; i < grid.size(); ++i)
+      fields[s * grid.size() + i] = data->b_current[i] != 0.f ? model.seeded(s) : model.initial(s);
+  }
+
+  ModelSolver *solver = NULL;
+  if(_options.backend == "cpu")
+    solver = new ModelCpuSolver(grid, model, &fields[0], _options.threads);
+  else
+    solver = new ModelClSolver(grid, model, &fields[0], _options);
+  std::cout << "Model " << model.name() << " with " << model.species() << " species on the " << _options.backend << " backend" << std::endl;
+  std::cout << "Seed: " << seed << std::endl;
+
+  boost::chrono::high_resolution_clock::time_point timer_start = boost::chrono::high_resolution_clock::now();
+  solver->step(_options.steps);
+  solver->finish();
+  boost::chrono::high_resolution_clock::time_point timer_end = boost::chrono::high_resolution_clock::now();
+
+  double seconds = boost::chrono::duration_cast<boost::chrono::duration<double> >(timer_end - timer_start).count();
+  std::cout << "Iterations: " << solver->iteration() << std::endl;
+  std::cout << "Seconds: " << seconds << std::endl;
+  std::cout << "Steps per second: " << (seconds > 0.0 ? _options.steps / seconds : 0.0) << std::endl;
+  std::cout << "Simulated time: " << static_cast<double>(solver->iteration()) * model.delta() << std::endl;
+
+  // Write the final field of every species as raw floats of width x height
+  std::string names;
+  for(int s = 0; s < model.species(); ++s)
+  {
+    solver->read(s, data->a_buffer);
+    write_field(_options.output + "_" + model.speciesName(s) + ".raw", data->a_buffer, grid);
+    names += (s ? "," : "") + model.speciesName(s);
+  }
+  std::cout << "Wrote " << grid.width << "x" << grid.height << " fields to " << _options.output << "_{" << names << "}.raw" << std::endl;
+
+  delete solver;
+  delete data;
+
+  return EXIT_SUCCESS;
+}
+
+// Split a comma separated list, skipping empty entries
+std::vector<std::string> split_list(const std::string &_list)
+{
+  std::vector<std::string> values;
+  std::istringstream stream(_list);
+  std::string value;
+  while(std::getline(stream, value, ','))
+  {
+    if(!value.empty())
+      values.push_back(value);
+  }
+
+  return values;
+}
+
+// Quote a string for JSON output
+std::string json_string(const std::string &_value)
+{
+  std::string quoted = "\"";
+  for(std::size_t i = 0; i < _value.size(); ++i)
+  {
+    if(_value[i] == '"' || _value[i] == '\\')
+      quoted += '\\';
+    quoted += _value[i];
+  }
+
+  return quoted + "\"";
+}
+
+// Name of the device a solver runs on, for benchmark reports
+std::string bench_device(Solver *_solver)
+{
+  CpuSolver *cpu_solver = dynamic_cast<CpuSolver*>(_solver);
+  if(cpu_solver != NULL)
+    return std::string("cpu ") + cpu_solver->kernel();
+
+  MultiSolver *multi_solver = dynamic_cast<MultiSolver*>(_solver);
+  if(multi_solver != NULL)
+  {
+    std::ostringstream name;
+    name << "multi " << multi_solver->devices() << " devices";
+    return name.str();
+  }
+
+  char name[256] = {0};
+  clGetDeviceInfo(static_cast<ClSolver*>(_solver)->environment()->device(), CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+  return name;
+}
+
+// Time every combination of backend, grid size, layout and work-group size.
+// Each is reported in cell updates per second, with the spread over repeated
+// runs and the bandwidth of the compulsory stencil traffic, which reads a and
+// b and writes them back once per cell and step.
+int run_bench(const Options &_options, const InputData &_input)
+{
+  const std::vector<std::string> sizes = split_list(_options.bench_sizes);
+  const std::vector<std::string> locals = split_list(_options.bench_local);
+  const std::vector<std::string> layouts = split_list(_options.bench_layouts);
+  const std::vector<std::string> backends = split_list(_options.bench_backends);
+
+  // Check the whole matrix before spending time on any of it
+  std::vector<Grid> grids;
+  for(std::size_t i = 0; i < sizes.size(); ++i)
+  {
+    int width = 0, height = 0;
+    if(sscanf(sizes[i].c_str(), "%dx%d", &width, &height) != 2 || width < 3 || height < 3)
+    {
+      std::cout << "Invalid grid size " << sizes[i] << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    grids.push_back(Grid(width, height));
+  }
+  for(std::size_t i = 0; i < locals.size(); ++i)
+  {
+    unsigned int x = 0, y = 0;
+    if(sscanf(locals[i].c_str(), "%ux%u", &x, &y) != 2 || x == 0 || y == 0)
+    {
+      std::cout << "Invalid work-group size " << locals[i] << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  for(std::size_t i = 0; i < layouts.size(); ++i)
+    layout_from_name(layouts[i]);
+  for(std::size_t i = 0; i < backends.size(); ++i)
+  {
+    if(backends[i] != "opencl" && backends[i] != "cpu" && backends[i] != "multi")
+    {
+      std::cout << "Unknown backend " << backends[i] << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  const double traffic = 4.0 * storage_bytes(storage_from_name(_options.storage));
+  const unsigned int steps = _options.bench_steps;
+  const unsigned int repeats = _options.bench_repeats;
+
+  std::ofstream csv((_options.output + "_bench.csv").c_str());
+  std::ofstream json((_options.output + "_bench.json").c_str());
+  csv << "backend,device,width,height,layout,storage,local,steps,repeats,updates_per_second,stddev,min,max,cv,gb_per_second" << std::endl;
+  json << "{" << std::endl;
+  json << "  \"storage\": " << json_string(_options.storage) << "," << std::endl;
+  json << "  \"kernel\": " << json_string(_options.kernel) << "," << std::endl;
+  json << "  \"block\": " << _options.block << "," << std::endl;
+  json << "  \"steps\": " << steps << "," << std::endl;
+  json << "  \"repeats\": " << repeats << "," << std::endl;
+  json << "  \"results\": [";
+
+  bool first = true;
+  for(std::size_t i = 0; i < backends.size(); ++i)
+  {
+    // Work-group sizes only apply to the OpenCL tiled and blocked kernels
+    std::vector<std::string> groups(1, "-");
+    if(backends[i] == "opencl" && (_options.kernel == "tiled" || _options.block > 1))
+      groups = locals;
+
+    for(std::size_t j = 0; j < grids.size(); ++j)
+    {
+      const Grid &grid = grids[j];
+      SimData *data = new SimData(grid);
+      initialise(data, _options, initial_seed(_options));
+
+      for(std::size_t l = 0; l < layouts.size(); ++l)
+      {
+        for(std::size_t g = 0; g < groups.size(); ++g)
+        {
+          Options options = _options;
+          options.layout = layouts[l];
+          if(groups[g] != "-")
+            sscanf(groups[g].c_str(), "%ux%u", &options.local_x, &options.local_y);
+
+          Solver *solver = create_solver(backends[i], options, _input, grid, data->a_current, data->b_current);
+          const std::string device = bench_device(solver);
+
+          solver->step(std::min(steps, static_cast<unsigned int>(BENCH_WARMUP)));
+          solver->finish();
+
+          // Cell updates per second of each timed run
+          std::vector<double> rates;
+          for(unsigned int r = 0; r < repeats; ++r)
+          {
+            boost::chrono::high_resolution_clock::time_point timer_start = boost::chrono::high_resolution_clock::now();
+            solver->step(steps);
+            solver->finish();
+            boost::chrono::high_resolution_clock::time_point timer_end = boost::chrono::high_resolution_clock::now();
+
+            double seconds = boost::chrono::duration_cast<boost::chrono::duration<double> >(timer_end - timer_start).count();
+            rates.push_back(seconds > 0.0 ? static_cast<double>(grid.cells()) * steps / seconds : 0.0);
+          }
+          delete solver;
+
+          double mean = 0.0, deviation = 0.0;
+          for(std::size_t r = 0; r < rates.size(); ++r)
+            mean += rates[r] / rates.size();
+          for(std::size_t r = 0; r < rates.size(); ++r)
+            deviation += (rates[r] - mean) * (rates[r] - mean);
+          deviation = rates.size() > 1 ? std::sqrt(deviation / (rates.size() - 1)) : 0.0;
+
+          const double minimum = *std::min_element(rates.begin(), rates.end());
+          const double maximum = *std::max_element(rates.begin(), rates.end());
+          const double variation = mean > 0.0 ? deviation / mean : 0.0;
+          const double bandwidth = mean * traffic / 1e9;
+
+          std::cout << backends[i] << " " << grid.width << "x" << grid.height << " " << layouts[l] << " " << groups[g] << ": "
+                    << mean << " cell updates/s (+-" << 100.0 * variation << "%), " << bandwidth << " GB/s on " << device << std::endl;
+
+          csv << backends[i] << "," << device << "," << grid.width << "," << grid.height << "," << layouts[l] << "," << _options.storage << "," << groups[g] << ","
+              << steps << "," << repeats << "," << mean << "," << deviation << "," << minimum << "," << maximum << "," << variation << "," << bandwidth << std::endl;
+
+          json << (first ? "" : ",") << std::endl;
+          json << "    {\"backend\": " << json_string(backends[i]) << ", \"device\": " << json_string(device)
+               << ", \"width\": " << grid.width << ", \"height\": " << grid.height
+               << ", \"layout\": " << json_string(layouts[l]) << ", \"local\": " << json_string(groups[g])
+               << ", \"updates_per_second\": " << mean << ", \"stddev\": " << deviation
+               << ", \"min\": " << minimum << ", \"max\": " << maximum
+               << ", \"cv\": " << variation << ", \"gb_per_second\": " << bandwidth << "}";
+          first = false;
+        }
+      }
+
+      delete data;
+    }
+  }
+
+  json << std::endl << "  ]" << std::endl << "}" << std::endl;
+  std::cout << "Wrote results to " << _options.output << "_bench.{json,csv}" << std::endl;
+
+  return EXIT_SUCCESS;
 }
 
 int main(int argc, char const *argv[])
 {
+  Options options = parse_options(argc, argv);
+
   // Simulation parameters
   InputData input;
   input.Da = 1.f;
@@ -124,163 +906,151 @@ int main(int argc, char const *argv[])
   input.k = 0.051f;
   input.delta = 0.8f;
 
-  //Create framebuffer for displaying simulation
-  Framebuffer *framebuffer = new Framebuffer();
+  // Volumes run alone on the OpenCL solver, headless or shown a plane at a time
+  if(options.depth > 1 && (!options.model.empty() || options.compare || options.storage_report || options.sweep || options.bench || options.ranks > 0))
+  {
+    std::cout << "Volumes cannot be combined with --model, --compare, --storage-report, --sweep, --bench or --ranks." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // Maps only reach the solvers made by create_solver
+  if((!options.map_f.empty() || !options.map_k.empty()) && (!options.model.empty() || options.sweep || options.ranks > 0))
+  {
+    std::cout << "Parameter maps cannot be combined with --model, --sweep or --ranks." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if(!options.model.empty())
+    exit(run_model(options));
+
+  if(options.compare)
+    exit(run_compare(options, input));
+
+  if(options.storage_report)
+    exit(run_storage_report(options, input));
+
+  if(options.sweep)
+    exit(run_sweep(options, input));
+
+  if(options.bench)
+    exit(run_bench(options, input));
+
+  if(options.ranks > 0)
+    exit(run_distributed(options, input));
+
+  if(options.headless)
+    exit(run_headless(options, input));
+
+  // Domains larger than the window are shown downsampled, each pixel averaging a block of cells
+  const Grid grid(options.width, options.height, options.depth);
+  if(options.downsample == 0)
+    options.downsample = std::max(1, std::max((grid.width + MAX_WINDOW_X - 1) / MAX_WINDOW_X, (grid.height + MAX_WINDOW_Y - 1) / MAX_WINDOW_Y));
+
+  //Create framebuffer for displaying simulation with a texture of the downsampled grid
+  const int texture_x = (grid.width + options.downsample - 1) / options.downsample;
+  const int texture_y = (grid.height + options.downsample - 1) / options.downsample;
+  Framebuffer *framebuffer = new Framebuffer(texture_x, texture_y);
+
+  // Scale the window down to fit large grids, keeping their aspect ratio
+  float window_scale = std::min(1.f, std::min(MAX_WINDOW_X / static_cast<float>(grid.width), MAX_WINDOW_Y / static_cast<float>(grid.height)));
+  int window_x = std::max(1, static_cast<int>(grid.width * window_scale));
+  int window_y = std::max(1, static_cast<int>(grid.height * window_scale));
 
   // Initializing framebuffer and override key callback with input
-  GLFWwindow* window = framebuffer->init(WIDTH, HEIGHT, &input);
+  GLFWwindow* window = framebuffer->init(window_x, window_y, &input);
   glfwSetKeyCallback(window, keyCallback);
 
   // Initial values for simulation
-  SimData *data = new SimData;
-  Perlin perlin;
-  for(int i = 0; i < SIZE; ++i)
-  {
-    float xpos = i % WIDTH;
-    float ypos = i / WIDTH;
-
-    data->a_current[i] = 1.f;
-    data->b_current[i] = 0.f;
-
-    if(perlin.noise(xpos / 100, ypos / 100, 0) > 0.4f)
-      data->b_current[i] = 1.f;
-
-    data->a_buffer[i] = 0.f;
-    data->b_buffer[i] = 0.f;
-  }
-
-  // OpenCL setup
-  cl_platform_id platform_id;
-  clGetPlatformIDs(1, &platform_id, NULL);
-  cl_uint device_count;
-  clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_GPU, 0, NULL, &device_count);
-  cl_device_id *device_ids = new cl_device_id[device_count];
-  clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_GPU, device_count, device_ids, NULL);
-
-  // Error code
-  cl_int error = CL_SUCCESS;
-
-  #ifdef __APPLE__
-    CGLContextObj cgl_context = CGLGetCurrentContext();
-    CGLShareGroupObj sharegroup = CGLGetShareGroup(cgl_context);
-
-    const cl_context_properties context_properties[] = {
-      CL_CONTEXT_PROPERTY_USE_CGL_SHAREGROUP_APPLE, (cl_context_properties)sharegroup,
-      CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(platform_id),
-      0
-    };
-  #elif __linux__
-    const cl_context_properties context_properties[] = {
-      CL_GL_CONTEXT_KHR, (cl_context_properties)glXGetCurrentContext(),
-      CL_GLX_DISPLAY_KHR, (cl_context_properties)glXGetCurrentDisplay(),
-      CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(platform_id),
-      0
-    };
-  #elif _WIN32
-    const cl_context_properties context_properties[] = {
-      CL_GL_CONTEXT_KHR, (cl_context_properties)wglGetCurrentContext(),
-      CL_WGL_HDC_KHR, (cl_context_properties)wglGetCurrentDC(),
-      CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(platform_id),
-      0
-    };
-  #endif
-
-  // Context creation
-  cl_context context = clCreateContext(context_properties, device_count, device_ids, NULL, NULL, &error);
-  opencl_error_check(error);
-
-  // Memory allocation
-  cl_mem cMem_a = clCreateBuffer(context, CL_MEM_WRITE_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * SIZE, data->a_current, &error);
-  opencl_error_check(error);
-  cl_mem cMem_b = clCreateBuffer(context, CL_MEM_WRITE_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * SIZE, data->b_current, &error);
-  opencl_error_check(error);
-  cl_mem bMem_a = clCreateBuffer(context, CL_MEM_WRITE_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * SIZE, data->a_buffer, &error);
-  opencl_error_check(error);
-  cl_mem bMem_b = clCreateBuffer(context, CL_MEM_WRITE_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * SIZE, data->b_buffer, &error);
-  opencl_error_check(error);
-  cl_mem cl_image = clCreateFromGLTexture(context, CL_MEM_WRITE_ONLY, GL_TEXTURE_2D, 0, framebuffer->texture(), &error);
-  opencl_error_check(error);
-
-  // Load source file
-  std::string file = read_file("kernels/image.cl");
-  const char* source[] = {file.c_str()};
-
-  // Build program
-  cl_program program = clCreateProgramWithSource(context, 1, source, NULL, &error);
-  opencl_error_check(error);
-  error = clBuildProgram(program, device_count, device_ids, NULL, NULL, NULL);
-  if(error != CL_SUCCESS)
-  {
-    char buffer[1024];
-    clGetProgramBuildInfo(program, device_ids[0], CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, NULL);
-    std::cout << buffer << std::endl;
-    exit(EXIT_FAILURE);
-  }
+  SimData *data = new SimData(grid);
+  initialise(data, options, initial_seed(options));
 
-  // Resolution for kernel
-  const float width = WIDTH;
-  const float height = HEIGHT;
-
-  // Create kernel one
-  cl_kernel kernel_one = clCreateKernel(program, "square", &error);
-  opencl_error_check(error);
-
-  // Set arguments for kernel one
-  clSetKernelArg(kernel_one, 0, sizeof(cl_mem), &cMem_a);
-  clSetKernelArg(kernel_one, 1, sizeof(cl_mem), &cMem_b);
-  clSetKernelArg(kernel_one, 2, sizeof(cl_mem), &bMem_a);
-  clSetKernelArg(kernel_one, 3, sizeof(cl_mem), &bMem_b);
-  clSetKernelArg(kernel_one, 4, sizeof(cl_mem), &cl_image);
-  clSetKernelArg(kernel_one, 5, sizeof(InputData), &input);
-  clSetKernelArg(kernel_one, 6, sizeof(float), &width);
-  clSetKernelArg(kernel_one, 7, sizeof(float), &height);
-
-  // Create kernel two
-  cl_kernel kernel_two = clCreateKernel(program, "square", &error);
-  opencl_error_check(error);
-
-  // Set arguments for kernel two
-  clSetKernelArg(kernel_two, 0, sizeof(cl_mem), &bMem_a);
-  clSetKernelArg(kernel_two, 1, sizeof(cl_mem), &bMem_b);
-  clSetKernelArg(kernel_two, 2, sizeof(cl_mem), &cMem_a);
-  clSetKernelArg(kernel_two, 3, sizeof(cl_mem), &cMem_b);
-  clSetKernelArg(kernel_two, 4, sizeof(cl_mem), &cl_image);
-  clSetKernelArg(kernel_two, 5, sizeof(InputData), &input);
-  clSetKernelArg(kernel_two, 6, sizeof(float), &width);
-  clSetKernelArg(kernel_two, 7, sizeof(float), &height);
-
-  // Create queue
-  cl_command_queue queue = clCreateCommandQueue(context, device_ids[0], 0, &error);
-  opencl_error_check(error);
+  // Solver setup drawing into the framebuffer's texture
+  Solver *solver = create_solver(options.backend, options, input, grid, data->a_current, data->b_current, framebuffer);
 
   // Make sure framebuffer's data is bound
   framebuffer->bind();
 
-  unsigned int iteration = 0;
+  // Pipelined frames are presented on the OpenCL solver's display queue
+  ClSolver *cl_solver = dynamic_cast<ClSolver*>(solver);
+  const bool pipelined = options.pipeline && cl_solver != NULL;
+  if(options.pipeline && !pipelined)
+    std::cout << "The pipeline needs the opencl backend, frames are presented after their steps." << std::endl;
+
   boost::chrono::milliseconds iteration_delta(static_cast<int>((1000.f / 60.f) * input.delta));
 
+  // Steps per frame, fixed or adapted to fill the frame time
+  FrameScheduler scheduler(iteration_delta.count() / 1000.0, options.steps_per_frame);
+  boost::chrono::high_resolution_clock::time_point title_time = boost::chrono::high_resolution_clock::now();
+  unsigned int title_iteration = solver->iteration();
+
+  // Optional timings of each frame's stages, dumped every few seconds and on exit
+  Profiler *profiler = create_profiler(options, solver);
+  boost::chrono::high_resolution_clock::time_point profile_time = title_time;
+
   while( !framebuffer->close() )
   {
     //Start loop timer
     boost::chrono::high_resolution_clock::time_point timer_start = boost::chrono::high_resolution_clock::now();
 
-    // Get image
-    clEnqueueAcquireGLObjects(queue, 1, &cl_image, 0, NULL, NULL);
-
-    // Run queue
-    std::size_t size[] = {SIZE};
-    error = clEnqueueNDRangeKernel(queue, (iteration % 2) ? kernel_one : kernel_two, 1, 0, size, NULL, 0, NULL, NULL);
-    opencl_error_check(error);
+    // Run the frame's steps with the coefficients set from the keyboard, then
+    // map the latest state into the shared image once
+    const unsigned int steps = scheduler.steps();
+    solver->parameters(input);
+    if(pipelined)
+    {
+      // The window shows the state stepped by the previous frame while this
+      // frame's steps run, and only waits for the image to be released. The
+      // time recorded is that of the previous frame's steps left to run.
+      solver->present();
+      solver->step(steps);
+      cl_solver->waitPresent();
+    }
+    else
+    {
+      solver->step(steps);
+      solver->present();
+      solver->finish();
+    }
 
-    // Release image
-    clEnqueueReleaseGLObjects(queue, 1, &cl_image, 0, NULL, NULL);
+    boost::chrono::high_resolution_clock::time_point timer_stepped = boost::chrono::high_resolution_clock::now();
+    scheduler.record(steps, boost::chrono::duration_cast<boost::chrono::duration<double> >(timer_stepped - timer_start).count());
 
     // Draw framebuffer
     framebuffer->draw();
 
-    // Update title with iteration count
-    std::string title = "Graphics Environment Iteration: " + std::to_string(++iteration);
-    framebuffer->title(title);
+    if(profiler != NULL)
+    {
+      boost::chrono::high_resolution_clock::time_point timer_drawn = boost::chrono::high_resolution_clock::now();
+      profiler->record(PROFILE_DRAW, boost::chrono::duration_cast<boost::chrono::duration<double, boost::milli> >(timer_drawn - timer_stepped).count());
+      profiler->record(PROFILE_FRAME, boost::chrono::duration_cast<boost::chrono::duration<double, boost::milli> >(timer_drawn - timer_start).count());
+      profiler->collect();
+
+      if(boost::chrono::duration_cast<boost::chrono::milliseconds>(timer_drawn - profile_time).count() >= PROFILE_INTERVAL)
+      {
+        profiler->dump(std::cout);
+        profile_time = timer_drawn;
+      }
+    }
+
+    // Update title with iteration count and rate a few times a second
+    double title_seconds = boost::chrono::duration_cast<boost::chrono::duration<double> >(timer_stepped - title_time).count();
+    if(title_seconds * 1000.0 >= TITLE_INTERVAL)
+    {
+      const double rate = (solver->iteration() - title_iteration) / title_seconds;
+      std::string title = "Graphics Environment Iteration: " + std::to_string(solver->iteration()) + " (" + std::to_string(static_cast<long long>(rate)) + " steps/s)";
+
+      // Overlay of the median and tail frame times while profiling
+      if(profiler != NULL)
+      {
+        char timings[64];
+        snprintf(timings, sizeof(timings), " frame p50 %.2f ms, p99 %.2f ms", profiler->percentile(PROFILE_FRAME, 50.0), profiler->percentile(PROFILE_FRAME, 99.0));
+        title += timings;
+      }
+
+      framebuffer->title(title);
+      title_time = timer_stepped;
+      title_iteration = solver->iteration();
+    }
 
     // Sleep thread so that time is consistent
     boost::chrono::high_resolution_clock::time_point timer_end = boost::chrono::high_resolution_clock::now();
@@ -291,19 +1061,12 @@ int main(int argc, char const *argv[])
     }    
   }
 
-  // Cleanup
-  clReleaseCommandQueue(queue);
-  clReleaseMemObject(cl_image);
-  clReleaseMemObject(bMem_b);
-  clReleaseMemObject(bMem_a);
-  clReleaseMemObject(cMem_b);
-  clReleaseMemObject(cMem_a);
-  clReleaseKernel(kernel_two);
-  clReleaseKernel(kernel_one);
-  clReleaseProgram(program);
-  clReleaseContext(context);
-  delete[] device_ids;
+  if(profiler != NULL)
+    profiler->dump(std::cout);
 
+  // Cleanup
+  delete solver;
+  delete profiler;
   delete data;
   delete framebuffer;
 